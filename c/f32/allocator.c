@@ -0,0 +1,162 @@
+#include "allocator.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+// malloc's memory is aligned for any standard type, which covers every
+// alignment this allows.
+static void* heap_allocate(
+    void* state,
+    const size_t size,
+    const size_t alignment
+) {
+    (void) state;
+    (void) alignment;
+    return malloc(size);
+}
+
+
+static void heap_release(
+    void* state,
+    void* pointer
+) {
+    (void) state;
+    free(pointer);
+}
+
+
+static void* arena_allocate_callback(
+    void* state,
+    const size_t size,
+    const size_t alignment
+) {
+    return arena_allocate((Arena*) state, size, alignment);
+}
+
+
+static void arena_release_callback(
+    void* state,
+    void* pointer
+) {
+    (void) state;
+    (void) pointer;
+}
+
+
+const Allocator ALLOCATOR_HEAP = {
+    .allocate = heap_allocate,
+    .release = heap_release,
+    .state = NULL
+};
+
+
+void* allocator_allocate(
+    const Allocator* self,
+    const size_t size,
+    const size_t alignment
+) {
+    return self->allocate(self->state, size, alignment);
+}
+
+
+void allocator_release(
+    const Allocator* self,
+    void* pointer
+) {
+    if (pointer) {
+        self->release(self->state, pointer);
+    }
+}
+
+
+int arena_init(
+    Arena* out_arena,
+    const size_t capacity
+) {
+    out_arena->_buffer = (unsigned char*) malloc(capacity);
+    out_arena->size = 0;
+    out_arena->capacity = out_arena->_buffer ? capacity : 0;
+    out_arena->_owns_buffer = 1;
+    return out_arena->_buffer != NULL;
+}
+
+
+void arena_init_buffer(
+    Arena* out_arena,
+    void* buffer,
+    const size_t capacity
+) {
+    out_arena->_buffer = (unsigned char*) buffer;
+    out_arena->size = 0;
+    out_arena->capacity = capacity;
+    out_arena->_owns_buffer = 0;
+}
+
+
+void arena_free(
+    Arena* self
+) {
+    if (self->_owns_buffer) {
+        free(self->_buffer);
+    }
+    self->_buffer = NULL;
+    self->size = 0;
+    self->capacity = 0;
+}
+
+
+void* arena_allocate(
+    Arena* self,
+    const size_t size,
+    const size_t alignment
+) {
+    // Aligned by address, since a caller's buffer may not be.
+    const uintptr_t base = (uintptr_t) self->_buffer;
+    const uintptr_t aligned = (base + self->size + alignment - 1)
+        & ~((uintptr_t) alignment - 1);
+    const size_t offset = (size_t)(aligned - base);
+    
+    if (offset > self->capacity || size > self->capacity - offset) {
+        return NULL;
+    }
+    
+    self->size = offset + size;
+    return self->_buffer + offset;
+}
+
+
+void arena_reset(
+    Arena* self
+) {
+    self->size = 0;
+}
+
+
+size_t arena_mark(
+    const Arena* self
+) {
+    return self->size;
+}
+
+
+void arena_rewind(
+    Arena* self,
+    const size_t mark
+) {
+    if (mark < self->size) {
+        self->size = mark;
+    }
+}
+
+
+Allocator arena_allocator(
+    Arena* self
+) {
+    const Allocator allocator = {
+        .allocate = arena_allocate_callback,
+        .release = arena_release_callback,
+        .state = self
+    };
+    return allocator;
+}
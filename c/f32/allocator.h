@@ -0,0 +1,94 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+
+// Pluggable allocation for functions that return variable size output, so
+// callers choose where that output lives. ALLOCATOR_HEAP is malloc and
+// free. An Arena hands out memory by bumping an offset into one buffer,
+// and is emptied in O(1) with arena_reset, typically once per frame, so
+// output that only lives for a frame costs no allocator calls at all.
+//
+// Alignments must be powers of 2, at most 16 for ALLOCATOR_HEAP.
+//
+// Never write to struct fields directly.
+// It's ok to read `size` and `capacity` of an Arena.
+
+typedef struct Allocator {
+    // Returns NULL if the memory could not be allocated.
+    void* (*allocate)(void* state, const size_t size, const size_t alignment);
+    // Releasing NULL does nothing.
+    void (*release)(void* state, void* pointer);
+    void* state;
+} Allocator;
+
+extern const Allocator ALLOCATOR_HEAP;
+
+typedef struct Arena {
+    unsigned char* _buffer;
+    size_t size;
+    size_t capacity;
+    int _owns_buffer;
+} Arena;
+
+
+void* allocator_allocate(
+    const Allocator* self,
+    const size_t size,
+    const size_t alignment
+);
+
+void allocator_release(
+    const Allocator* self,
+    void* pointer
+);
+
+
+// Allocates the arena's buffer. Returns 0 if the allocation failed.
+int arena_init(
+    Arena* out_arena,
+    const size_t capacity
+);
+
+// Uses memory owned by the caller, for example a static or stack buffer.
+void arena_init_buffer(
+    Arena* out_arena,
+    void* buffer,
+    const size_t capacity
+);
+
+void arena_free(
+    Arena* self
+);
+
+// Returns NULL if the arena does not have `size` bytes left at the
+// alignment. The arena never grows, so earlier allocations do not move.
+void* arena_allocate(
+    Arena* self,
+    const size_t size,
+    const size_t alignment
+);
+
+// Releases every allocation at once.
+void arena_reset(
+    Arena* self
+);
+
+// Scratch use within a frame: allocations made after arena_mark are
+// released by arena_rewind to that mark, leaving earlier ones.
+size_t arena_mark(
+    const Arena* self
+);
+
+void arena_rewind(
+    Arena* self,
+    const size_t mark
+);
+
+// An Allocator that allocates from the arena, and whose release does
+// nothing. Valid for as long as the arena is.
+Allocator arena_allocator(
+    Arena* self
+);
+
+#endif
@@ -0,0 +1,47 @@
+#include "float_env.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define FLOAT_ENV_SSE
+    // MXCSR flush to zero and denormals are zero bits.
+    #define MXCSR_FTZ 0x8000
+    #define MXCSR_DAZ 0x0040
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+    #define FLOAT_ENV_AARCH64
+    // FPCR flush to zero bit, which covers inputs and outputs.
+    #define FPCR_FZ (1ull << 24)
+#endif
+
+
+int float_env_flush_denormals(
+    FloatEnvironment* out_saved
+) {
+    #if defined(FLOAT_ENV_SSE)
+        const unsigned int control = _mm_getcsr();
+        out_saved->_control = control;
+        _mm_setcsr(control | MXCSR_FTZ | MXCSR_DAZ);
+        return 1;
+    #elif defined(FLOAT_ENV_AARCH64)
+        unsigned long long control;
+        __asm__ volatile ("mrs %0, fpcr" : "=r" (control));
+        out_saved->_control = control;
+        __asm__ volatile ("msr fpcr, %0" : : "r" (control | FPCR_FZ));
+        return 1;
+    #else
+        out_saved->_control = 0;
+        return 0;
+    #endif
+}
+
+
+void float_env_restore(
+    const FloatEnvironment* saved
+) {
+    #if defined(FLOAT_ENV_SSE)
+        _mm_setcsr((unsigned int)saved->_control);
+    #elif defined(FLOAT_ENV_AARCH64)
+        __asm__ volatile ("msr fpcr, %0" : : "r" (saved->_control));
+    #else
+        (void)saved;
+    #endif
+}
@@ -0,0 +1,31 @@
+#ifndef FLOAT_ENV_H
+#define FLOAT_ENV_H
+
+// Control of the denormal handling of the current thread's floating point
+// environment, for batch kernels that should never pay for denormals.
+//
+// Flush to zero (FTZ) replaces denormal results with zero, and denormals
+// are zero (DAZ) treats denormal inputs as zero. Both are non IEEE, so
+// enable them around a kernel and restore the environment afterwards:
+//
+//   FloatEnvironment saved;
+//   float_env_flush_denormals(&saved);
+//   spring_lanes_evaluate(&lanes, count, now);
+//   float_env_restore(&saved);
+
+typedef struct FloatEnvironment {
+    unsigned long long _control;
+} FloatEnvironment;
+
+
+// Saves the environment into `out_saved` and enables FTZ and DAZ. Returns 0
+// if the target has no such control, in which case nothing is changed.
+int float_env_flush_denormals(
+    FloatEnvironment* out_saved
+);
+
+void float_env_restore(
+    const FloatEnvironment* saved
+);
+
+#endif
@@ -0,0 +1,60 @@
+#include "frame_clock.h"
+
+#include <math.h>
+
+
+void frame_clock_init(
+    FrameClock* out_clock,
+    const double start_time,
+    const double fixed_step
+) {
+    out_clock->time = start_time;
+    out_clock->fixed_step = fixed_step > 0 ? fixed_step : 0.0;
+    out_clock->_remainder = 0.0;
+}
+
+
+size_t frame_clock_advance(
+    FrameClock* self,
+    const double delta
+) {
+    if (!(delta > 0)) {
+        return 0;
+    }
+    
+    if (self->fixed_step == 0.0) {
+        self->time += delta;
+        return 1;
+    }
+    
+    const double elapsed = self->_remainder + delta;
+    const double steps = floor(elapsed / self->fixed_step);
+    
+    // Multiplying instead of summing steps keeps long runs from drifting.
+    self->time += steps * self->fixed_step;
+    self->_remainder = elapsed - steps * self->fixed_step;
+    
+    return (size_t)steps;
+}
+
+
+size_t frame_clock_advance_to(
+    FrameClock* self,
+    const double now
+) {
+    return frame_clock_advance(self, now - (self->time + self->_remainder));
+}
+
+
+double frame_clock_alpha(
+    const FrameClock* self
+) {
+    return self->fixed_step > 0 ? self->_remainder / self->fixed_step : 0.0;
+}
+
+
+double frame_clock_read(
+    void* frame_clock
+) {
+    return ((const FrameClock*)frame_clock)->time;
+}
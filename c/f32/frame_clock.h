@@ -0,0 +1,54 @@
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <stddef.h>
+
+// A time source shared by many springs. It is advanced once per frame, so
+// springs reading it do a load instead of calling a clock function.
+//
+// With a `fixed_step` above zero, time only moves in whole steps and the
+// remainder is carried over to the next frame.
+//
+// Never write to struct fields directly.
+// It's ok to read from the fields.
+
+typedef struct FrameClock {
+    double time;
+    double fixed_step;
+    double _remainder;
+} FrameClock;
+
+
+void frame_clock_init(
+    FrameClock* out_clock,
+    const double start_time,
+    const double fixed_step
+);
+
+// Moves time forward by `delta`. Returns the number of fixed steps taken,
+// or 1 without a fixed step.
+size_t frame_clock_advance(
+    FrameClock* self,
+    const double delta
+);
+
+// Advances to an absolute time, such as a clock_gettime reading taken once
+// per frame. Earlier times are ignored. Returns as frame_clock_advance.
+size_t frame_clock_advance_to(
+    FrameClock* self,
+    const double now
+);
+
+// How far time is into the next fixed step, in [0, 1). Always 0 without a
+// fixed step.
+double frame_clock_alpha(
+    const FrameClock* self
+);
+
+// Reads a FrameClock through the clock callback form, for APIs that take a
+// `double (*)(void*)` and state pointer.
+double frame_clock_read(
+    void* frame_clock
+);
+
+#endif
@@ -0,0 +1,644 @@
+#include "imu_filter.h"
+
+#include <math.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+    
+    #define v_load(p) _mm_loadu_ps(p)
+    #define v_store(p, a) _mm_storeu_ps(p, a)
+    #define v_set _mm_set1_ps
+    #define v_add _mm_add_ps
+    #define v_sub _mm_sub_ps
+    #define v_mul _mm_mul_ps
+    #define v_neg(a) _mm_xor_ps(a, _mm_set1_ps(-0.0f))
+#endif
+
+
+// Streams are updated four at a time with SSE2, and the rest one at a time.
+// Both paths do the same operations in the same order, with per stream
+// special cases handled by masks rather than branches, so a stream's result
+// does not depend on its position in the arrays.
+
+static inline float inv_sqrt_or_zero(const float value) {
+    return value > 0 ? 1.0f / sqrtf(value) : 0.0f;
+}
+
+
+#if defined(__SSE2__)
+static inline __m128 inv_sqrt_or_zero_lanes(const __m128 value) {
+    const __m128 positive = _mm_cmpgt_ps(value, _mm_setzero_ps());
+    return _mm_and_ps(positive, _mm_div_ps(v_set(1.0f), _mm_sqrt_ps(value)));
+}
+
+
+static inline __m128 length_squared_lanes(
+    const __m128 x,
+    const __m128 y,
+    const __m128 z
+) {
+    return v_add(v_add(v_mul(x, x), v_mul(y, y)), v_mul(z, z));
+}
+
+
+// Renormalizes and stores the orientations of streams i to i + 3.
+static inline void store_normalized_lanes(
+    ImuFilterState* state,
+    const size_t i,
+    const __m128 nx,
+    const __m128 ny,
+    const __m128 nz,
+    const __m128 nw
+) {
+    const __m128 length_squared = v_add(
+        v_add(v_add(v_mul(nw, nw), v_mul(nx, nx)), v_mul(ny, ny)), v_mul(nz, nz)
+    );
+    const __m128 n_recip = _mm_div_ps(v_set(1.0f), _mm_sqrt_ps(length_squared));
+    
+    v_store(&(state->qx[i]), v_mul(nx, n_recip));
+    v_store(&(state->qy[i]), v_mul(ny, n_recip));
+    v_store(&(state->qz[i]), v_mul(nz, n_recip));
+    v_store(&(state->qw[i]), v_mul(nw, n_recip));
+}
+
+
+// imu_madgwick_update for streams i to i + 3.
+static inline void madgwick_lanes(
+    ImuFilterState* state,
+    const ImuSamples* samples,
+    const size_t i,
+    const int has_mag,
+    const float beta,
+    const float timestep
+) {
+    const __m128 one = v_set(1.0f);
+    const __m128 two = v_set(2.0f);
+    const __m128 four = v_set(4.0f);
+    const __m128 half = v_set(0.5f);
+    
+    const __m128 x = v_load(&(state->qx[i]));
+    const __m128 y = v_load(&(state->qy[i]));
+    const __m128 z = v_load(&(state->qz[i]));
+    const __m128 w = v_load(&(state->qw[i]));
+    const __m128 gx = v_load(&(samples->gx[i]));
+    const __m128 gy = v_load(&(samples->gy[i]));
+    const __m128 gz = v_load(&(samples->gz[i]));
+    
+    const __m128 ax_in = v_load(&(samples->ax[i]));
+    const __m128 ay_in = v_load(&(samples->ay[i]));
+    const __m128 az_in = v_load(&(samples->az[i]));
+    const __m128 a_recip = inv_sqrt_or_zero_lanes(
+        length_squared_lanes(ax_in, ay_in, az_in)
+    );
+    const __m128 ax = v_mul(ax_in, a_recip);
+    const __m128 ay = v_mul(ay_in, a_recip);
+    const __m128 az = v_mul(az_in, a_recip);
+    
+    const __m128 xx = v_mul(x, x);
+    const __m128 yy = v_mul(y, y);
+    const __m128 xz_wy = v_sub(v_mul(x, z), v_mul(w, y));
+    const __m128 wx_yz = v_add(v_mul(w, x), v_mul(y, z));
+    
+    const __m128 f1 = v_sub(v_mul(two, xz_wy), ax);
+    const __m128 f2 = v_sub(v_mul(two, wx_yz), ay);
+    const __m128 f3 = v_sub(v_sub(one, v_mul(two, v_add(xx, yy))), az);
+    
+    const __m128 two_x = v_mul(two, x);
+    const __m128 two_y = v_mul(two, y);
+    const __m128 two_z = v_mul(two, z);
+    const __m128 two_w = v_mul(two, w);
+    
+    __m128 sw = v_add(v_mul(v_neg(two_y), f1), v_mul(two_x, f2));
+    __m128 sx = v_sub(
+        v_add(v_mul(two_z, f1), v_mul(two_w, f2)), v_mul(v_mul(four, x), f3)
+    );
+    __m128 sy = v_sub(
+        v_add(v_mul(v_neg(two_w), f1), v_mul(two_z, f2)), v_mul(v_mul(four, y), f3)
+    );
+    __m128 sz = v_add(v_mul(two_x, f1), v_mul(two_y, f2));
+    
+    if (has_mag) {
+        const __m128 mx_in = v_load(&(samples->mx[i]));
+        const __m128 my_in = v_load(&(samples->my[i]));
+        const __m128 mz_in = v_load(&(samples->mz[i]));
+        const __m128 m_recip = inv_sqrt_or_zero_lanes(
+            length_squared_lanes(mx_in, my_in, mz_in)
+        );
+        const __m128 mx = v_mul(mx_in, m_recip);
+        const __m128 my = v_mul(my_in, m_recip);
+        const __m128 mz = v_mul(mz_in, m_recip);
+        
+        const __m128 ww = v_mul(w, w);
+        const __m128 zz = v_mul(z, z);
+        const __m128 xy_wz = v_sub(v_mul(x, y), v_mul(w, z));
+        const __m128 wy_xz = v_add(v_mul(w, y), v_mul(x, z));
+        
+        const __m128 hx = v_add(
+            v_add(
+                v_mul(mx, v_sub(v_sub(v_add(ww, xx), yy), zz)),
+                v_mul(v_mul(two, my), xy_wz)
+            ),
+            v_mul(v_mul(two, mz), wy_xz)
+        );
+        const __m128 hy = v_add(
+            v_add(
+                v_mul(v_mul(two, mx), v_add(v_mul(w, z), v_mul(x, y))),
+                v_mul(my, v_sub(v_add(v_sub(ww, xx), yy), zz))
+            ),
+            v_mul(v_mul(two, mz), v_sub(v_mul(y, z), v_mul(w, x)))
+        );
+        const __m128 b2x = _mm_sqrt_ps(v_add(v_mul(hx, hx), v_mul(hy, hy)));
+        const __m128 b2z = v_add(
+            v_add(v_mul(v_mul(two, mx), xz_wy), v_mul(v_mul(two, my), wx_yz)),
+            v_mul(mz, v_add(v_sub(v_sub(ww, xx), yy), zz))
+        );
+        const __m128 b4x = v_mul(two, b2x);
+        const __m128 b4z = v_mul(two, b2z);
+        
+        const __m128 f4 = v_sub(
+            v_add(v_mul(b2x, v_sub(v_sub(half, yy), zz)), v_mul(b2z, xz_wy)), mx
+        );
+        const __m128 f5 = v_sub(v_add(v_mul(b2x, xy_wz), v_mul(b2z, wx_yz)), my);
+        const __m128 f6 = v_sub(
+            v_add(v_mul(b2x, wy_xz), v_mul(b2z, v_sub(v_sub(half, xx), yy))), mz
+        );
+        
+        sw = v_add(sw, v_add(
+            v_add(
+                v_mul(v_mul(v_neg(b2z), y), f4),
+                v_mul(v_add(v_mul(v_neg(b2x), z), v_mul(b2z, x)), f5)
+            ),
+            v_mul(v_mul(b2x, y), f6)
+        ));
+        sx = v_add(sx, v_add(
+            v_add(
+                v_mul(v_mul(b2z, z), f4),
+                v_mul(v_add(v_mul(b2x, y), v_mul(b2z, w)), f5)
+            ),
+            v_mul(v_sub(v_mul(b2x, z), v_mul(b4z, x)), f6)
+        ));
+        sy = v_add(sy, v_add(
+            v_add(
+                v_mul(v_sub(v_mul(v_neg(b4x), y), v_mul(b2z, w)), f4),
+                v_mul(v_add(v_mul(b2x, x), v_mul(b2z, z)), f5)
+            ),
+            v_mul(v_sub(v_mul(b2x, w), v_mul(b4z, y)), f6)
+        ));
+        sz = v_add(sz, v_add(
+            v_add(
+                v_mul(v_add(v_mul(v_neg(b4x), z), v_mul(b2z, x)), f4),
+                v_mul(v_add(v_mul(v_neg(b2x), w), v_mul(b2z, y)), f5)
+            ),
+            v_mul(v_mul(b2x, x), f6)
+        ));
+    }
+    
+    // No correction for streams with a zero accelerometer sample.
+    const __m128 s_length_squared = v_add(
+        v_add(v_add(v_mul(sw, sw), v_mul(sx, sx)), v_mul(sy, sy)), v_mul(sz, sz)
+    );
+    const __m128 gain = _mm_and_ps(
+        _mm_cmpgt_ps(a_recip, _mm_setzero_ps()),
+        v_mul(v_set(beta), inv_sqrt_or_zero_lanes(s_length_squared))
+    );
+    
+    const __m128 dw = v_sub(
+        v_mul(half, v_sub(v_sub(v_mul(v_neg(x), gx), v_mul(y, gy)), v_mul(z, gz))),
+        v_mul(gain, sw)
+    );
+    const __m128 dx = v_sub(
+        v_mul(half, v_sub(v_add(v_mul(w, gx), v_mul(y, gz)), v_mul(z, gy))),
+        v_mul(gain, sx)
+    );
+    const __m128 dy = v_sub(
+        v_mul(half, v_add(v_sub(v_mul(w, gy), v_mul(x, gz)), v_mul(z, gx))),
+        v_mul(gain, sy)
+    );
+    const __m128 dz = v_sub(
+        v_mul(half, v_sub(v_add(v_mul(w, gz), v_mul(x, gy)), v_mul(y, gx))),
+        v_mul(gain, sz)
+    );
+    
+    const __m128 dt = v_set(timestep);
+    store_normalized_lanes(
+        state, i,
+        v_add(x, v_mul(dx, dt)),
+        v_add(y, v_mul(dy, dt)),
+        v_add(z, v_mul(dz, dt)),
+        v_add(w, v_mul(dw, dt))
+    );
+}
+
+
+// imu_mahony_update for streams i to i + 3.
+static inline void mahony_lanes(
+    ImuFilterState* state,
+    const ImuSamples* samples,
+    const size_t i,
+    const int has_mag,
+    const int has_integral,
+    const float two_kp,
+    const float two_ki_dt,
+    const float half_dt
+) {
+    const __m128 two = v_set(2.0f);
+    const __m128 half = v_set(0.5f);
+    
+    const __m128 x = v_load(&(state->qx[i]));
+    const __m128 y = v_load(&(state->qy[i]));
+    const __m128 z = v_load(&(state->qz[i]));
+    const __m128 w = v_load(&(state->qw[i]));
+    
+    const __m128 ax_in = v_load(&(samples->ax[i]));
+    const __m128 ay_in = v_load(&(samples->ay[i]));
+    const __m128 az_in = v_load(&(samples->az[i]));
+    const __m128 a_recip = inv_sqrt_or_zero_lanes(
+        length_squared_lanes(ax_in, ay_in, az_in)
+    );
+    const __m128 ax = v_mul(ax_in, a_recip);
+    const __m128 ay = v_mul(ay_in, a_recip);
+    const __m128 az = v_mul(az_in, a_recip);
+    
+    const __m128 xx = v_mul(x, x);
+    const __m128 yy = v_mul(y, y);
+    
+    const __m128 vx = v_sub(v_mul(x, z), v_mul(w, y));
+    const __m128 vy = v_add(v_mul(w, x), v_mul(y, z));
+    const __m128 vz = v_sub(v_sub(half, xx), yy);
+    
+    __m128 ex = v_sub(v_mul(ay, vz), v_mul(az, vy));
+    __m128 ey = v_sub(v_mul(az, vx), v_mul(ax, vz));
+    __m128 ez = v_sub(v_mul(ax, vy), v_mul(ay, vx));
+    
+    if (has_mag) {
+        const __m128 mx_in = v_load(&(samples->mx[i]));
+        const __m128 my_in = v_load(&(samples->my[i]));
+        const __m128 mz_in = v_load(&(samples->mz[i]));
+        const __m128 m_recip = inv_sqrt_or_zero_lanes(
+            length_squared_lanes(mx_in, my_in, mz_in)
+        );
+        const __m128 mx = v_mul(mx_in, m_recip);
+        const __m128 my = v_mul(my_in, m_recip);
+        const __m128 mz = v_mul(mz_in, m_recip);
+        
+        const __m128 zz = v_mul(z, z);
+        const __m128 half_yy_zz = v_sub(v_sub(half, yy), zz);
+        const __m128 xy_wz = v_sub(v_mul(x, y), v_mul(w, z));
+        
+        const __m128 hx = v_mul(two, v_add(
+            v_add(v_mul(mx, half_yy_zz), v_mul(my, xy_wz)),
+            v_mul(mz, v_add(v_mul(x, z), v_mul(w, y)))
+        ));
+        const __m128 hy = v_mul(two, v_add(
+            v_add(
+                v_mul(mx, v_add(v_mul(x, y), v_mul(w, z))),
+                v_mul(my, v_sub(v_sub(half, xx), zz))
+            ),
+            v_mul(mz, v_sub(v_mul(y, z), v_mul(w, x)))
+        ));
+        const __m128 bx = _mm_sqrt_ps(v_add(v_mul(hx, hx), v_mul(hy, hy)));
+        const __m128 bz = v_mul(two, v_add(
+            v_add(v_mul(mx, vx), v_mul(my, v_add(v_mul(y, z), v_mul(w, x)))),
+            v_mul(mz, vz)
+        ));
+        
+        const __m128 hwx = v_add(v_mul(bx, half_yy_zz), v_mul(bz, vx));
+        const __m128 hwy = v_add(v_mul(bx, xy_wz), v_mul(bz, vy));
+        const __m128 hwz = v_add(
+            v_mul(bx, v_add(v_mul(w, y), v_mul(x, z))), v_mul(bz, vz)
+        );
+        
+        ex = v_add(ex, v_sub(v_mul(my, hwz), v_mul(mz, hwy)));
+        ey = v_add(ey, v_sub(v_mul(mz, hwx), v_mul(mx, hwz)));
+        ez = v_add(ez, v_sub(v_mul(mx, hwy), v_mul(my, hwx)));
+    }
+    
+    // No correction for streams with a zero accelerometer sample.
+    const __m128 feedback = _mm_and_ps(
+        _mm_cmpgt_ps(a_recip, _mm_setzero_ps()), v_set(1.0f)
+    );
+    ex = v_mul(ex, feedback);
+    ey = v_mul(ey, feedback);
+    ez = v_mul(ez, feedback);
+    
+    const __m128 kp = v_set(two_kp);
+    __m128 gx = v_add(v_load(&(samples->gx[i])), v_mul(kp, ex));
+    __m128 gy = v_add(v_load(&(samples->gy[i])), v_mul(kp, ey));
+    __m128 gz = v_add(v_load(&(samples->gz[i])), v_mul(kp, ez));
+    
+    if (has_integral) {
+        const __m128 ki = v_set(two_ki_dt);
+        const __m128 ix = v_add(v_load(&(state->ix[i])), v_mul(ki, ex));
+        const __m128 iy = v_add(v_load(&(state->iy[i])), v_mul(ki, ey));
+        const __m128 iz = v_add(v_load(&(state->iz[i])), v_mul(ki, ez));
+        v_store(&(state->ix[i]), ix);
+        v_store(&(state->iy[i]), iy);
+        v_store(&(state->iz[i]), iz);
+        gx = v_add(gx, ix);
+        gy = v_add(gy, iy);
+        gz = v_add(gz, iz);
+    }
+    
+    const __m128 dt = v_set(half_dt);
+    const __m128 dw = v_sub(v_sub(v_mul(v_neg(x), gx), v_mul(y, gy)), v_mul(z, gz));
+    const __m128 dx = v_sub(v_add(v_mul(w, gx), v_mul(y, gz)), v_mul(z, gy));
+    const __m128 dy = v_add(v_sub(v_mul(w, gy), v_mul(x, gz)), v_mul(z, gx));
+    const __m128 dz = v_sub(v_add(v_mul(w, gz), v_mul(x, gy)), v_mul(y, gx));
+    store_normalized_lanes(
+        state, i,
+        v_add(x, v_mul(dx, dt)),
+        v_add(y, v_mul(dy, dt)),
+        v_add(z, v_mul(dz, dt)),
+        v_add(w, v_mul(dw, dt))
+    );
+}
+#endif
+
+
+void imu_filter_reset(
+    ImuFilterState* state,
+    const size_t count
+) {
+    for (size_t i = 0; i < count; i++) {
+        state->qx[i] = 0.0f;
+        state->qy[i] = 0.0f;
+        state->qz[i] = 0.0f;
+        state->qw[i] = 1.0f;
+    }
+    
+    if (!state->ix) {
+        return;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        state->ix[i] = 0.0f;
+        state->iy[i] = 0.0f;
+        state->iz[i] = 0.0f;
+    }
+}
+
+
+// Gradient descent on the accelerometer (and magnetometer) error, followed by
+// a quaternion_derivative step: q += (0.5 * q * gyro - beta * gradient) * dt
+void imu_madgwick_update(
+    ImuFilterState* state,
+    const ImuSamples* samples,
+    const size_t count,
+    const float beta,
+    const float timestep
+) {
+    float* restrict qx_out = state->qx;
+    float* restrict qy_out = state->qy;
+    float* restrict qz_out = state->qz;
+    float* restrict qw_out = state->qw;
+    const float* restrict gx_in = samples->gx;
+    const float* restrict gy_in = samples->gy;
+    const float* restrict gz_in = samples->gz;
+    const float* restrict ax_in = samples->ax;
+    const float* restrict ay_in = samples->ay;
+    const float* restrict az_in = samples->az;
+    const float* restrict mx_in = samples->mx;
+    const float* restrict my_in = samples->my;
+    const float* restrict mz_in = samples->mz;
+    const int has_mag = mx_in && my_in && mz_in;
+    
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        madgwick_lanes(state, samples, i, has_mag, beta, timestep);
+    }
+#endif
+
+    for (; i < count; i++) {
+        const float x = qx_out[i];
+        const float y = qy_out[i];
+        const float z = qz_out[i];
+        const float w = qw_out[i];
+        const float gx = gx_in[i];
+        const float gy = gy_in[i];
+        const float gz = gz_in[i];
+        
+        const float a_recip = inv_sqrt_or_zero(
+            ax_in[i] * ax_in[i] + ay_in[i] * ay_in[i] + az_in[i] * az_in[i]
+        );
+        const float ax = ax_in[i] * a_recip;
+        const float ay = ay_in[i] * a_recip;
+        const float az = az_in[i] * a_recip;
+        
+        const float xx = x * x;
+        const float yy = y * y;
+        
+        // Error between measured and predicted gravity, and its gradient.
+        const float f1 = 2.0f * (x * z - w * y) - ax;
+        const float f2 = 2.0f * (w * x + y * z) - ay;
+        const float f3 = 1.0f - 2.0f * (xx + yy) - az;
+        
+        float sw = -2.0f * y * f1 + 2.0f * x * f2;
+        float sx = 2.0f * z * f1 + 2.0f * w * f2 - 4.0f * x * f3;
+        float sy = -2.0f * w * f1 + 2.0f * z * f2 - 4.0f * y * f3;
+        float sz = 2.0f * x * f1 + 2.0f * y * f2;
+        
+        if (has_mag) {
+            const float m_recip = inv_sqrt_or_zero(
+                mx_in[i] * mx_in[i] + my_in[i] * my_in[i] + mz_in[i] * mz_in[i]
+            );
+            const float mx = mx_in[i] * m_recip;
+            const float my = my_in[i] * m_recip;
+            const float mz = mz_in[i] * m_recip;
+            
+            const float ww = w * w;
+            const float zz = z * z;
+            
+            // Earth frame magnetic field, flattened onto the x-z plane.
+            const float hx = mx * (ww + xx - yy - zz)
+                + 2.0f * my * (x * y - w * z)
+                + 2.0f * mz * (w * y + x * z);
+            const float hy = 2.0f * mx * (w * z + x * y)
+                + my * (ww - xx + yy - zz)
+                + 2.0f * mz * (y * z - w * x);
+            const float b2x = sqrtf(hx * hx + hy * hy);
+            const float b2z = 2.0f * mx * (x * z - w * y)
+                + 2.0f * my * (w * x + y * z)
+                + mz * (ww - xx - yy + zz);
+            const float b4x = 2.0f * b2x;
+            const float b4z = 2.0f * b2z;
+            
+            const float f4 = b2x * (0.5f - yy - zz) + b2z * (x * z - w * y) - mx;
+            const float f5 = b2x * (x * y - w * z) + b2z * (w * x + y * z) - my;
+            const float f6 = b2x * (w * y + x * z) + b2z * (0.5f - xx - yy) - mz;
+            
+            sw += -b2z * y * f4 + (-b2x * z + b2z * x) * f5 + b2x * y * f6;
+            sx += b2z * z * f4 + (b2x * y + b2z * w) * f5
+                + (b2x * z - b4z * x) * f6;
+            sy += (-b4x * y - b2z * w) * f4 + (b2x * x + b2z * z) * f5
+                + (b2x * w - b4z * y) * f6;
+            sz += (-b4x * z + b2z * x) * f4 + (-b2x * w + b2z * y) * f5
+                + b2x * x * f6;
+        }
+        
+        // No correction for streams with a zero accelerometer sample.
+        const float gain = a_recip > 0
+            ? beta * inv_sqrt_or_zero(sw * sw + sx * sx + sy * sy + sz * sz)
+            : 0.0f;
+        
+        const float dw = 0.5f * (-x * gx - y * gy - z * gz) - gain * sw;
+        const float dx = 0.5f * (w * gx + y * gz - z * gy) - gain * sx;
+        const float dy = 0.5f * (w * gy - x * gz + z * gx) - gain * sy;
+        const float dz = 0.5f * (w * gz + x * gy - y * gx) - gain * sz;
+        
+        const float nw = w + dw * timestep;
+        const float nx = x + dx * timestep;
+        const float ny = y + dy * timestep;
+        const float nz = z + dz * timestep;
+        const float n_recip = 1.0f / sqrtf(nw * nw + nx * nx + ny * ny + nz * nz);
+        
+        qx_out[i] = nx * n_recip;
+        qy_out[i] = ny * n_recip;
+        qz_out[i] = nz * n_recip;
+        qw_out[i] = nw * n_recip;
+    }
+}
+
+
+// Proportional-integral feedback of the cross product between measured and
+// predicted directions into the gyro rate, followed by a
+// quaternion_derivative step with the corrected rate.
+void imu_mahony_update(
+    ImuFilterState* state,
+    const ImuSamples* samples,
+    const size_t count,
+    const float kp,
+    const float ki,
+    const float timestep
+) {
+    float* restrict qx_out = state->qx;
+    float* restrict qy_out = state->qy;
+    float* restrict qz_out = state->qz;
+    float* restrict qw_out = state->qw;
+    float* restrict ix_out = state->ix;
+    float* restrict iy_out = state->iy;
+    float* restrict iz_out = state->iz;
+    const float* restrict gx_in = samples->gx;
+    const float* restrict gy_in = samples->gy;
+    const float* restrict gz_in = samples->gz;
+    const float* restrict ax_in = samples->ax;
+    const float* restrict ay_in = samples->ay;
+    const float* restrict az_in = samples->az;
+    const float* restrict mx_in = samples->mx;
+    const float* restrict my_in = samples->my;
+    const float* restrict mz_in = samples->mz;
+    const int has_mag = mx_in && my_in && mz_in;
+    const int has_integral_state = ix_out && iy_out && iz_out;
+    const int has_integral = ki > 0 && has_integral_state;
+    const float two_kp = 2.0f * kp;
+    const float two_ki_dt = 2.0f * ki * timestep;
+    const float half_dt = 0.5f * timestep;
+    
+    // Turning the integral gain off also drops the feedback accumulated so
+    // far, rather than holding it until the gain is turned back on.
+    if (!has_integral && has_integral_state) {
+        for (size_t i = 0; i < count; i++) {
+            ix_out[i] = 0.0f;
+            iy_out[i] = 0.0f;
+            iz_out[i] = 0.0f;
+        }
+    }
+    
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        mahony_lanes(
+            state, samples, i, has_mag, has_integral, two_kp, two_ki_dt, half_dt
+        );
+    }
+#endif
+
+    for (; i < count; i++) {
+        const float x = qx_out[i];
+        const float y = qy_out[i];
+        const float z = qz_out[i];
+        const float w = qw_out[i];
+        
+        const float a_recip = inv_sqrt_or_zero(
+            ax_in[i] * ax_in[i] + ay_in[i] * ay_in[i] + az_in[i] * az_in[i]
+        );
+        const float ax = ax_in[i] * a_recip;
+        const float ay = ay_in[i] * a_recip;
+        const float az = az_in[i] * a_recip;
+        
+        const float xx = x * x;
+        const float yy = y * y;
+        
+        // Half of the predicted gravity direction in the sensor frame.
+        const float vx = x * z - w * y;
+        const float vy = w * x + y * z;
+        const float vz = 0.5f - xx - yy;
+        
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+        
+        if (has_mag) {
+            const float m_recip = inv_sqrt_or_zero(
+                mx_in[i] * mx_in[i] + my_in[i] * my_in[i] + mz_in[i] * mz_in[i]
+            );
+            const float mx = mx_in[i] * m_recip;
+            const float my = my_in[i] * m_recip;
+            const float mz = mz_in[i] * m_recip;
+            
+            const float zz = z * z;
+            
+            const float hx = 2.0f * (mx * (0.5f - yy - zz)
+                + my * (x * y - w * z) + mz * (x * z + w * y));
+            const float hy = 2.0f * (mx * (x * y + w * z)
+                + my * (0.5f - xx - zz) + mz * (y * z - w * x));
+            const float bx = sqrtf(hx * hx + hy * hy);
+            const float bz = 2.0f * (mx * (x * z - w * y)
+                + my * (y * z + w * x) + mz * (0.5f - xx - yy));
+            
+            // Half of the predicted magnetic field in the sensor frame.
+            const float hwx = bx * (0.5f - yy - zz) + bz * (x * z - w * y);
+            const float hwy = bx * (x * y - w * z) + bz * (w * x + y * z);
+            const float hwz = bx * (w * y + x * z) + bz * (0.5f - xx - yy);
+            
+            ex += my * hwz - mz * hwy;
+            ey += mz * hwx - mx * hwz;
+            ez += mx * hwy - my * hwx;
+        }
+        
+        // No correction for streams with a zero accelerometer sample.
+        const float feedback = a_recip > 0 ? 1.0f : 0.0f;
+        ex *= feedback;
+        ey *= feedback;
+        ez *= feedback;
+        
+        float gx = gx_in[i] + two_kp * ex;
+        float gy = gy_in[i] + two_kp * ey;
+        float gz = gz_in[i] + two_kp * ez;
+        
+        if (has_integral) {
+            const float ix = ix_out[i] + two_ki_dt * ex;
+            const float iy = iy_out[i] + two_ki_dt * ey;
+            const float iz = iz_out[i] + two_ki_dt * ez;
+            ix_out[i] = ix;
+            iy_out[i] = iy;
+            iz_out[i] = iz;
+            gx += ix;
+            gy += iy;
+            gz += iz;
+        }
+        
+        const float nw = w + (-x * gx - y * gy - z * gz) * half_dt;
+        const float nx = x + (w * gx + y * gz - z * gy) * half_dt;
+        const float ny = y + (w * gy - x * gz + z * gx) * half_dt;
+        const float nz = z + (w * gz + x * gy - y * gx) * half_dt;
+        const float n_recip = 1.0f / sqrtf(nw * nw + nx * nx + ny * ny + nz * nz);
+        
+        qx_out[i] = nx * n_recip;
+        qy_out[i] = ny * n_recip;
+        qz_out[i] = nz * n_recip;
+        qw_out[i] = nw * n_recip;
+    }
+}
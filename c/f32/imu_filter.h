@@ -0,0 +1,68 @@
+#ifndef IMU_FILTER_H
+#define IMU_FILTER_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Attitude estimation for many independent IMU streams at once.
+// All arrays are structure of arrays with one entry per stream, and each
+// update steps every stream by one sample, four streams at a time with SSE2.
+// The gyro step is the first order quaternion_derivative step, followed by
+// renormalization.
+//
+// Orientations rotate from the sensor frame to the earth frame, with gravity
+// measured along +z when the sensor is level.
+
+typedef struct ImuFilterState {
+    float* qx;
+    float* qy;
+    float* qz;
+    float* qw;
+    // Integral feedback used by Mahony when ki > 0, and cleared by updates
+    // with ki <= 0. May be NULL if ki is never positive.
+    float* ix;
+    float* iy;
+    float* iz;
+} ImuFilterState;
+
+typedef struct ImuSamples {
+    // Angular rate in radians per second.
+    const float* gx;
+    const float* gy;
+    const float* gz;
+    // Accelerometer, any unit. A zero sample disables feedback for a stream.
+    const float* ax;
+    const float* ay;
+    const float* az;
+    // Magnetometer, any unit. Set to NULL for gyro and accelerometer only.
+    // A zero sample disables heading correction for a stream.
+    const float* mx;
+    const float* my;
+    const float* mz;
+} ImuSamples;
+
+
+// Sets every orientation to the identity and clears the integral feedback.
+void imu_filter_reset(
+    ImuFilterState* state,
+    const size_t count
+);
+
+void imu_madgwick_update(
+    ImuFilterState* state,
+    const ImuSamples* samples,
+    const size_t count,
+    const float beta,
+    const float timestep
+);
+
+void imu_mahony_update(
+    ImuFilterState* state,
+    const ImuSamples* samples,
+    const size_t count,
+    const float kp,
+    const float ki,
+    const float timestep
+);
+
+#endif
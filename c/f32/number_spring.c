@@ -0,0 +1,50 @@
+#include "number_spring.h"
+
+
+static inline float number_spring_difference(
+    const float* target,
+    const float* position
+) {
+    return *target - *position;
+}
+
+static inline float number_spring_madd(
+    const float a,
+    const float b,
+    const float scale
+) {
+    return a + b * scale;
+}
+
+static inline float number_spring_scale(
+    const float a,
+    const float scale
+) {
+    return a * scale;
+}
+
+static inline float number_spring_wrap(
+    const float position
+) {
+    return position;
+}
+
+static inline float number_spring_component(
+    const float* value,
+    const size_t index
+) {
+    (void)index;
+    return *value;
+}
+
+static inline void number_spring_set_component(
+    float* value,
+    const size_t index,
+    const float x
+) {
+    (void)index;
+    *value = x;
+}
+
+
+SPRING_DEFINE(NumberSpring, number_spring, float, NUMBER_SPRING_LANES, 0)
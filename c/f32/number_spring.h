@@ -0,0 +1,12 @@
+#ifndef NUMBER_SPRING_H
+#define NUMBER_SPRING_H
+
+#include "spring.h"
+
+// Spring for a single float, see spring.h for the generated functions.
+
+#define NUMBER_SPRING_LANES 1
+
+SPRING_DECLARE(NumberSpring, number_spring, float)
+
+#endif
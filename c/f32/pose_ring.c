@@ -0,0 +1,107 @@
+#include "pose_ring.h"
+
+#include <stdlib.h>
+
+#include "quaternion.h"
+#include "vector3.h"
+
+
+int pose_ring_init(
+    PoseRing* out_ring,
+    const size_t capacity
+) {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    
+    out_ring->_samples = (PoseSample*) malloc(rounded * sizeof(PoseSample));
+    out_ring->_mask = rounded - 1;
+    out_ring->_head = 0;
+    out_ring->_cached_tail = 0;
+    out_ring->_tail = 0;
+    out_ring->_cached_head = 0;
+    return out_ring->_samples != NULL;
+}
+
+
+void pose_ring_free(
+    PoseRing* self
+) {
+    free(self->_samples);
+    self->_samples = NULL;
+}
+
+
+int pose_ring_push(
+    PoseRing* self,
+    const double time,
+    const Quaternion* rotation,
+    const Vector3* position
+) {
+    const size_t head = self->_head;
+    
+    // Only reload the consumer's index when the ring looks full.
+    if (head - self->_cached_tail > self->_mask) {
+        self->_cached_tail = __atomic_load_n(&(self->_tail), __ATOMIC_ACQUIRE);
+        if (head - self->_cached_tail > self->_mask) {
+            return 0;
+        }
+    }
+    
+    PoseSample* sample = &(self->_samples[head & self->_mask]);
+    sample->rotation = *rotation;
+    sample->position = position ? *position : VECTOR3_ZERO;
+    sample->time = time;
+    
+    __atomic_store_n(&(self->_head), head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+
+int pose_ring_read_at(
+    PoseRing* self,
+    const double time,
+    Quaternion* out_rotation,
+    Vector3* out_position
+) {
+    size_t tail = self->_tail;
+    
+    // Only reload the producer's index when the known samples end before
+    // `time`.
+    size_t head = self->_cached_head;
+    if (tail == head || self->_samples[(head - 1) & self->_mask].time < time) {
+        head = __atomic_load_n(&(self->_head), __ATOMIC_ACQUIRE);
+        self->_cached_head = head;
+        if (tail == head) {
+            return 0;
+        }
+    }
+    
+    // Bounded by the capacity, so the read stays wait-free.
+    while (tail + 1 < head && self->_samples[(tail + 1) & self->_mask].time <= time) {
+        tail++;
+    }
+    if (tail != self->_tail) {
+        __atomic_store_n(&(self->_tail), tail, __ATOMIC_RELEASE);
+    }
+    
+    const PoseSample* before = &(self->_samples[tail & self->_mask]);
+    if (tail + 1 == head || time <= before->time) {
+        *out_rotation = quaternion_normalize(&(before->rotation));
+        if (out_position) {
+            *out_position = before->position;
+        }
+        return 1;
+    }
+    
+    const PoseSample* after = &(self->_samples[(tail + 1) & self->_mask]);
+    const float alpha = (float)((time - before->time) / (after->time - before->time));
+    *out_rotation = quaternion_slerp(&(before->rotation), &(after->rotation), alpha);
+    if (out_position) {
+        const Vector3 delta = vector3_sub(&(after->position), &(before->position));
+        const Vector3 step = vector3_scale(&delta, alpha);
+        *out_position = vector3_add(&(before->position), &step);
+    }
+    return 1;
+}
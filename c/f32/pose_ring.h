@@ -0,0 +1,75 @@
+#ifndef POSE_RING_H
+#define POSE_RING_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Lock-free single producer, single consumer ring of timed poses, for
+// handing samples from a simulation or sensor thread to a render thread
+// running at a different rate. One thread pushes and one thread reads;
+// neither ever waits for the other.
+//
+// The producer publishes each sample with a release store of its index,
+// and the consumer acquires it, so a sample is complete once visible. The
+// indices sit on their own cache lines, each next to the owning thread's
+// cached copy of the other index, so the threads only touch each other's
+// line when the cached copy runs out.
+//
+// Never write to struct fields directly.
+
+#define POSE_RING_CACHE_LINE 64
+
+typedef struct PoseSample {
+    Quaternion rotation;
+    Vector3 position;
+    double time;
+} PoseSample;
+
+typedef struct PoseRing {
+    PoseSample* _samples;
+    size_t _mask;
+    // Written by the producer: the index of the next sample, and the last
+    // tail it has seen.
+    ALIGN(POSE_RING_CACHE_LINE) size_t _head;
+    size_t _cached_tail;
+    // Written by the consumer: the index of the oldest sample still needed,
+    // and the last head it has seen.
+    ALIGN(POSE_RING_CACHE_LINE) size_t _tail;
+    size_t _cached_head;
+} PoseRing;
+
+
+// `capacity` is rounded up to a power of 2. Returns 0 if the allocation
+// failed.
+int pose_ring_init(
+    PoseRing* out_ring,
+    const size_t capacity
+);
+
+void pose_ring_free(
+    PoseRing* self
+);
+
+// Producer only. `time` must increase from push to push. `position` is
+// optional, and is stored as zero if NULL. Returns 0, dropping the sample,
+// if the ring is full because the consumer has fallen behind.
+int pose_ring_push(
+    PoseRing* self,
+    const double time,
+    const Quaternion* rotation,
+    const Vector3* position
+);
+
+// Consumer only, wait-free. Slerps the rotation and lerps the position
+// between the two samples around `time`, holding the first or last sample
+// outside of them. `out_position` is optional. Samples before the one at
+// or before `time` are released to the producer, so read times should not
+// decrease. Returns 0, without writing, if no sample has been pushed.
+int pose_ring_read_at(
+    PoseRing* self,
+    const double time,
+    Quaternion* out_rotation,
+    Vector3* out_position
+);
+
+#endif
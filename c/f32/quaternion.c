@@ -1,14 +1,33 @@
 #include "quaternion.h"
 
+#include <float.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define M_DEFINE_CONSTANTS
 #include "math_util.h"
 
+#include "simd_math.h"
 #include "vector3.h"
 
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+
+#define EPSILON 5e-7f
+
+// Quaternions with a squared length within UNIT_TOLERANCE of 1 take the
+// unit fast paths, which skip the length, its logarithm or its power. The
+// error of doing so is at most UNIT_TOLERANCE / 2.
+#define UNIT_TOLERANCE 1e-6f
+
+// Below this angle the series expansions are exact to float precision.
+#define SMALL_ANGLE 0.1f
+
+#define BATCH_BLOCK_SIZE 64
 
 const Quaternion QUATERNION_IDENTITY = { 0, 0, 0, 1 };
 const Quaternion QUATERNION_ZERO = { 0, 0, 0, 0 };
@@ -166,7 +185,7 @@ Quaternion quaternion_from_vector(
     const Vector3* vector,
     const float w
 ) {
-    
+    return quaternion_new(vector->x, vector->y, vector->z, w);
 }
 
 
@@ -241,7 +260,9 @@ Quaternion quaternion_add(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    return quaternion_new(
+        q0->x + q1->x, q0->y + q1->y, q0->z + q1->z, q0->w + q1->w
+    );
 }
 
 
@@ -249,7 +270,9 @@ Quaternion quaternion_sub(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    return quaternion_new(
+        q0->x - q1->x, q0->y - q1->y, q0->z - q1->z, q0->w - q1->w
+    );
 }
 
 
@@ -282,11 +305,80 @@ Quaternion quaternion_unm(
 }
 
 
+// sin(x) / x and cos(x), from x squared.
+static inline void sinc_cos(
+    const float xx,
+    float* out_sinc,
+    float* out_cos
+) {
+    if (xx < SMALL_ANGLE * SMALL_ANGLE) {
+        *out_sinc = 1 - xx * (1.0f / 6.0f - xx * (1.0f / 120.0f));
+        *out_cos = 1 - xx * (0.5f - xx * (1.0f / 24.0f));
+    } else {
+        const float x = sqrtf(xx);
+        *out_sinc = sinf(x) / x;
+        *out_cos = cosf(x);
+    }
+}
+
+
+// atan2(s, w) / s, from s squared. Zero if both are zero, and if s is zero
+// with a negative w, where the angle has no axis to scale.
+static inline float atan_ratio(
+    const float ss,
+    const float w
+) {
+    const float ww = w * w;
+    if (w > 0 && ss < SMALL_ANGLE * SMALL_ANGLE * ww) {
+        const float tt = ss / ww;
+        return (1 - tt * (1.0f / 3.0f - tt * (1.0f / 5.0f - tt * (1.0f / 7.0f)))) / w;
+    }
+    
+    const float s = sqrtf(ss);
+    return s > 0 ? atan2f(s, w) / s : 0.0f;
+}
+
+
+static inline int is_unit_length_squared(
+    const float length_squared
+) {
+    return fabsf(length_squared - 1) < UNIT_TOLERANCE;
+}
+
+
 Quaternion quaternion_pow(
     const Quaternion* q0,
     const float pow
 ) {
+    if (pow == -1) {
+        return quaternion_inverse(q0);
+    }
     
+    const float x = q0->x;
+    const float y = q0->y;
+    const float z = q0->z;
+    const float w = q0->w;
+    const float vv = x * x + y * y + z * z;
+    const float length_squared = vv + w * w;
+    const float magnitude = is_unit_length_squared(length_squared)
+        ? 1.0f
+        : powf(length_squared, 0.5f * pow);
+    
+    // Negative real quaternions are a half turn about no particular axis.
+    if (vv == 0) {
+        return quaternion_new(
+            0, 0, 0, w < 0 ? magnitude * cosf(pow * (float)PI) : magnitude
+        );
+    }
+    
+    // The result has `pow` times the angle, so its vector part is scaled by
+    // sin(pow * angle) / |v| = pow * (angle / |v|) * sinc(pow * angle).
+    const float angle_ratio = pow * atan_ratio(vv, w);
+    float sinc, c;
+    sinc_cos(vv * angle_ratio * angle_ratio, &sinc, &c);
+    const float s = magnitude * angle_ratio * sinc;
+    
+    return quaternion_new(x * s, y * s, z * s, magnitude * c);
 }
 
 
@@ -318,7 +410,9 @@ Quaternion quaternion_scale(
     const Quaternion* q0,
     const float scale
 ) {
-    
+    return quaternion_new(
+        q0->x * scale, q0->y * scale, q0->z * scale, q0->w * scale
+    );
 }
 
 
@@ -342,7 +436,18 @@ Vector3 quaternion_rotate_vector(
     const Quaternion* q0,
     const Vector3* vector
 ) {
+    // v' = v + w * t + u x t, where t = 2 * (u x v)
+    const float tx = 2.0f * (q0->y * vector->z - q0->z * vector->y);
+    const float ty = 2.0f * (q0->z * vector->x - q0->x * vector->z);
+    const float tz = 2.0f * (q0->x * vector->y - q0->y * vector->x);
     
+    Vector3 out = {
+        .x = vector->x + q0->w * tx + (q0->y * tz - q0->z * ty),
+        .y = vector->y + q0->w * ty + (q0->z * tx - q0->x * tz),
+        .z = vector->z + q0->w * tz + (q0->x * ty - q0->y * tx)
+    };
+    
+    return out;
 }
 
 
@@ -358,7 +463,9 @@ Quaternion quaternion_scale_inv(
     const Quaternion* q0,
     const float scale
 ) {
-    
+    return quaternion_new(
+        q0->x / scale, q0->y / scale, q0->z / scale, q0->w / scale
+    );
 }
 
 
@@ -371,14 +478,16 @@ Quaternion quaternion_scale_inv(
 Quaternion quaternion_unit(
     const Quaternion* q0
 ) {
-    
+    return quaternion_normalize(q0);
 }
 
 
 float quaternion_length(
     const Quaternion* q0
 ) {
-    
+    return sqrtf(
+        q0->x * q0->x + q0->y * q0->y + q0->z * q0->z + q0->w * q0->w
+    );
 }
 
 
@@ -392,14 +501,26 @@ float quaternion_length_acc(
 float quaternion_length_squared(
     const Quaternion* q0
 ) {
-    
+    return q0->x * q0->x + q0->y * q0->y + q0->z * q0->z + q0->w * q0->w;
 }
 
 
 Quaternion quaternion_exp(
     const Quaternion* q0
 ) {
+    const float x = q0->x;
+    const float y = q0->y;
+    const float z = q0->z;
+    
+    // Pure quaternions, such as the logarithms of unit quaternions, map to
+    // unit quaternions without the exponential.
+    const float m = q0->w == 0 ? 1.0f : expf(q0->w);
+    
+    float sinc, c;
+    sinc_cos(x * x + y * y + z * z, &sinc, &c);
+    const float s = m * sinc;
     
+    return quaternion_new(x * s, y * s, z * s, m * c);
 }
 
 
@@ -407,7 +528,8 @@ Quaternion quaternion_exp_map(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    const Quaternion exp_q1 = quaternion_exp(q1);
+    return quaternion_mul(q0, &exp_q1);
 }
 
 
@@ -415,14 +537,46 @@ Quaternion quaternion_exp_map_sym(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    const Quaternion sqrt_q0 = quaternion_pow(q0, 0.5f);
+    const Quaternion exp_q1 = quaternion_exp(q1);
+    const Quaternion half = quaternion_mul(&sqrt_q0, &exp_q1);
+    return quaternion_mul(&half, &sqrt_q0);
 }
 
 
+// acos(w / |q|) / |v| is computed as atan2(|v|, w) / |v|, which needs no
+// normalization and keeps its precision for small angles.
 Quaternion quaternion_log(
     const Quaternion* q0
 ) {
+    const float x = q0->x;
+    const float y = q0->y;
+    const float z = q0->z;
+    const float w = q0->w;
+    const float vv = x * x + y * y + z * z;
+    const float length_squared = vv + w * w;
+    
+    if (length_squared == 0) {
+        return quaternion_new(0, 0, 0, -HUGE_VALF);
+    }
+    
+    const float s = atan_ratio(vv, w);
+    const float log_length = is_unit_length_squared(length_squared)
+        ? 0.0f
+        : 0.5f * logf(length_squared);
     
+    return quaternion_new(x * s, y * s, z * s, log_length);
+}
+
+
+// The inverse of a unit quaternion is its conjugate.
+static inline Quaternion unit_inverse(
+    const Quaternion* q0
+) {
+    const float length_squared = quaternion_dot(q0, q0);
+    return is_unit_length_squared(length_squared)
+        ? quaternion_conjugate(q0)
+        : quaternion_inverse(q0);
 }
 
 
@@ -430,7 +584,9 @@ Quaternion quaternion_log_map(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    const Quaternion inverse_q0 = unit_inverse(q0);
+    const Quaternion relative = quaternion_mul(&inverse_q0, q1);
+    return quaternion_log(&relative);
 }
 
 
@@ -438,7 +594,245 @@ Quaternion quaternion_log_map_sym(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
+    const Quaternion inv_sqrt_q0 = quaternion_pow(q0, -0.5f);
+    const Quaternion half = quaternion_mul(&inv_sqrt_q0, q1);
+    const Quaternion relative = quaternion_mul(&half, &inv_sqrt_q0);
+    return quaternion_log(&relative);
+}
+
+
+// The batch versions stage each block of quaternions into arrays for the
+// simd_math functions, then assemble the results like the single versions.
+
+void quaternion_exp_batch(
+    const Quaternion q0[],
+    const size_t count,
+    Quaternion out[]
+) {
+    float angles[BATCH_BLOCK_SIZE];
+    float sines[BATCH_BLOCK_SIZE];
+    float cosines[BATCH_BLOCK_SIZE];
+    float scales[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion* q = &(q0[start + i]);
+            angles[i] = sqrtf(q->x * q->x + q->y * q->y + q->z * q->z);
+            scales[i] = q->w;
+        }
+        
+        simd_sincos(angles, block, sines, cosines, SIMD_MATH_PRECISE);
+        simd_exp(scales, block, scales, SIMD_MATH_PRECISE);
+        
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion q = q0[start + i];
+            const float angle = angles[i];
+            const float sinc = angle < SMALL_ANGLE
+                ? 1 - angle * angle * (1.0f / 6.0f - angle * angle * (1.0f / 120.0f))
+                : sines[i] / angle;
+            const float s = scales[i] * sinc;
+            out[start + i] = quaternion_new(
+                q.x * s, q.y * s, q.z * s, scales[i] * cosines[i]
+            );
+        }
+    }
+}
+
+
+void quaternion_log_batch(
+    const Quaternion q0[],
+    const size_t count,
+    Quaternion out[]
+) {
+    float lengths[BATCH_BLOCK_SIZE];
+    float scalars[BATCH_BLOCK_SIZE];
+    float angles[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion* q = &(q0[start + i]);
+            lengths[i] = sqrtf(q->x * q->x + q->y * q->y + q->z * q->z);
+            scalars[i] = q->w;
+        }
+        
+        simd_atan2(lengths, scalars, block, angles, SIMD_MATH_PRECISE);
+        
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion q = q0[start + i];
+            const float length_squared = quaternion_dot(&q, &q);
+            const float s = lengths[i] > 0 ? angles[i] / lengths[i] : 0.0f;
+            
+            float log_length;
+            if (is_unit_length_squared(length_squared)) {
+                log_length = 0.0f;
+            } else if (length_squared == 0) {
+                log_length = -HUGE_VALF;
+            } else {
+                log_length = 0.5f * logf(length_squared);
+            }
+            
+            out[start + i] = quaternion_new(q.x * s, q.y * s, q.z * s, log_length);
+        }
+    }
+}
+
+
+void quaternion_pow_batch(
+    const Quaternion q0[],
+    const size_t count,
+    const float pow,
+    Quaternion out[]
+) {
+    if (pow == -1) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = quaternion_inverse(&(q0[i]));
+        }
+        return;
+    }
+    
+    float lengths[BATCH_BLOCK_SIZE];
+    float scalars[BATCH_BLOCK_SIZE];
+    float angles[BATCH_BLOCK_SIZE];
+    float sines[BATCH_BLOCK_SIZE];
+    float cosines[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion* q = &(q0[start + i]);
+            lengths[i] = sqrtf(q->x * q->x + q->y * q->y + q->z * q->z);
+            scalars[i] = q->w;
+        }
+        
+        // A zero vector part gives an angle of 0 or pi, like quaternion_pow.
+        simd_atan2(lengths, scalars, block, angles, SIMD_MATH_PRECISE);
+        for (size_t i = 0; i < block; i++) {
+            angles[i] *= pow;
+        }
+        simd_sincos(angles, block, sines, cosines, SIMD_MATH_PRECISE);
+        
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion q = q0[start + i];
+            const float length_squared = quaternion_dot(&q, &q);
+            const float magnitude = is_unit_length_squared(length_squared)
+                ? 1.0f
+                : powf(length_squared, 0.5f * pow);
+            const float s = lengths[i] > 0
+                ? magnitude * sines[i] / lengths[i]
+                : 0.0f;
+            out[start + i] = quaternion_new(
+                q.x * s, q.y * s, q.z * s, magnitude * cosines[i]
+            );
+        }
+    }
+}
+
+
+void quaternion_exp_map_batch(
+    const Quaternion q0[],
+    const Quaternion q1[],
+    const size_t count,
+    Quaternion out[]
+) {
+    Quaternion exps[BATCH_BLOCK_SIZE];
     
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        quaternion_exp_batch(&(q1[start]), block, exps);
+        for (size_t i = 0; i < block; i++) {
+            out[start + i] = quaternion_mul(&(q0[start + i]), &(exps[i]));
+        }
+    }
+}
+
+
+void quaternion_exp_map_sym_batch(
+    const Quaternion q0[],
+    const Quaternion q1[],
+    const size_t count,
+    Quaternion out[]
+) {
+    Quaternion roots[BATCH_BLOCK_SIZE];
+    Quaternion exps[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        quaternion_pow_batch(&(q0[start]), block, 0.5f, roots);
+        quaternion_exp_batch(&(q1[start]), block, exps);
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion half = quaternion_mul(&(roots[i]), &(exps[i]));
+            out[start + i] = quaternion_mul(&half, &(roots[i]));
+        }
+    }
+}
+
+
+void quaternion_log_map_batch(
+    const Quaternion q0[],
+    const Quaternion q1[],
+    const size_t count,
+    Quaternion out[]
+) {
+    Quaternion relatives[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion inverse_q0 = unit_inverse(&(q0[start + i]));
+            relatives[i] = quaternion_mul(&inverse_q0, &(q1[start + i]));
+        }
+        quaternion_log_batch(relatives, block, &(out[start]));
+    }
+}
+
+
+void quaternion_log_map_sym_batch(
+    const Quaternion q0[],
+    const Quaternion q1[],
+    const size_t count,
+    Quaternion out[]
+) {
+    Quaternion roots[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        quaternion_pow_batch(&(q0[start]), block, -0.5f, roots);
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion half = quaternion_mul(&(roots[i]), &(q1[start + i]));
+            roots[i] = quaternion_mul(&half, &(roots[i]));
+        }
+        quaternion_log_batch(roots, block, &(out[start]));
+    }
 }
 
 
@@ -452,14 +846,137 @@ float quaternion_hypot(
 Quaternion quaternion_normalize(
     const Quaternion* q0
 ) {
+    const float length = quaternion_length(q0);
+    if (length > 0) {
+        return quaternion_scale(q0, 1.0f / length);
+    }
     
+    return QUATERNION_IDENTITY;
 }
 
 
-int quaternion_is_unit(
+// Dividing by the largest component, rather than multiplying by its
+// reciprocal, which is denormal for components above about 8.5e37 and
+// flushed to zero under FTZ.
+Quaternion quaternion_normalize_scaled(
     const Quaternion* q0
 ) {
+    const float largest = fmaxf(
+        fmaxf(fabsf(q0->x), fabsf(q0->y)),
+        fmaxf(fabsf(q0->z), fabsf(q0->w))
+    );
+    if (!(largest > 0) || largest > FLT_MAX) {
+        return QUATERNION_IDENTITY;
+    }
     
+    const Quaternion scaled = quaternion_scale_inv(q0, largest);
+    return quaternion_normalize(&scaled);
+}
+
+
+void quaternion_normalize_batch(
+    const Quaternion q0[],
+    const size_t count,
+    const float tolerance,
+    Quaternion out[]
+) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 magnitude_bits = _mm_castsi128_ps(
+        _mm_set1_epi32(0x7fffffff)
+    );
+    const __m128 tolerances = _mm_set1_ps(tolerance);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 three_halves = _mm_set1_ps(1.5f);
+    const __m128 smallest = _mm_set1_ps(FLT_MIN);
+    const __m128 largest = _mm_set1_ps(FLT_MAX);
+    
+    for (; i + 4 <= count; i += 4) {
+        const __m128 q[4] = {
+            _mm_load_ps(&(q0[i].x)),
+            _mm_load_ps(&(q0[i + 1].x)),
+            _mm_load_ps(&(q0[i + 2].x)),
+            _mm_load_ps(&(q0[i + 3].x))
+        };
+        
+        // Squared lengths, one lane per quaternion.
+        __m128 s0 = _mm_mul_ps(q[0], q[0]);
+        __m128 s1 = _mm_mul_ps(q[1], q[1]);
+        __m128 s2 = _mm_mul_ps(q[2], q[2]);
+        __m128 s3 = _mm_mul_ps(q[3], q[3]);
+        _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+        const __m128 length_squared = _mm_add_ps(
+            _mm_add_ps(s0, s1), _mm_add_ps(s2, s3)
+        );
+        
+        const __m128 error = _mm_and_ps(
+            _mm_sub_ps(length_squared, one), magnitude_bits
+        );
+        const __m128 keep = _mm_cmple_ps(error, tolerances);
+        const int unit = _mm_movemask_ps(keep);
+        if (unit == 0xF) {
+            if (out != q0) {
+                _mm_store_ps(&(out[i].x), q[0]);
+                _mm_store_ps(&(out[i + 1].x), q[1]);
+                _mm_store_ps(&(out[i + 2].x), q[2]);
+                _mm_store_ps(&(out[i + 3].x), q[3]);
+            }
+            continue;
+        }
+        
+        // One Newton step: e * (1.5 - 0.5 * x * e * e).
+        const __m128 estimate = _mm_rsqrt_ps(length_squared);
+        const __m128 half_x_e = _mm_mul_ps(
+            _mm_mul_ps(half, length_squared), estimate
+        );
+        __m128 scale = _mm_mul_ps(
+            estimate, _mm_sub_ps(three_halves, _mm_mul_ps(half_x_e, estimate))
+        );
+        scale = _mm_or_ps(_mm_and_ps(keep, one), _mm_andnot_ps(keep, scale));
+        
+        _mm_store_ps(&(out[i].x),
+            _mm_mul_ps(q[0], _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(0, 0, 0, 0))));
+        _mm_store_ps(&(out[i + 1].x),
+            _mm_mul_ps(q[1], _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(1, 1, 1, 1))));
+        _mm_store_ps(&(out[i + 2].x),
+            _mm_mul_ps(q[2], _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(2, 2, 2, 2))));
+        _mm_store_ps(&(out[i + 3].x),
+            _mm_mul_ps(q[3], _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(3, 3, 3, 3))));
+        
+        // Zero, denormal, overflowing or NaN lengths, where the estimate is
+        // not defined.
+        const int in_range = _mm_movemask_ps(_mm_and_ps(
+            _mm_cmpge_ps(length_squared, smallest),
+            _mm_cmple_ps(length_squared, largest)
+        ));
+        int fallback = ~(in_range | unit) & 0xF;
+        while (fallback) {
+            const int lane = __builtin_ctz((unsigned int) fallback);
+            fallback &= fallback - 1;
+            out[i + lane] = quaternion_normalize_scaled(&(q0[i + lane]));
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        const float length_squared = quaternion_length_squared(&(q0[i]));
+        if (fabsf(length_squared - 1) <= tolerance) {
+            out[i] = q0[i];
+        } else if (length_squared >= FLT_MIN && length_squared <= FLT_MAX) {
+            out[i] = quaternion_scale(&(q0[i]), 1.0f / sqrtf(length_squared));
+        } else {
+            out[i] = quaternion_normalize_scaled(&(q0[i]));
+        }
+    }
+}
+
+
+int quaternion_is_unit(
+    const Quaternion* q0
+) {
+    return fabsf(1.0f - quaternion_length(q0)) < EPSILON;
 }
 
 
@@ -467,28 +984,36 @@ float quaternion_dot(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    return q0->x * q1->x + q0->y * q1->y + q0->z * q1->z + q0->w * q1->w;
 }
 
 
 Quaternion quaternion_conjugate(
     const Quaternion* q0
 ) {
-    
+    return quaternion_new(-q0->x, -q0->y, -q0->z, q0->w);
 }
 
 
 Quaternion quaternion_inverse(
     const Quaternion* q0
 ) {
+    const float length_squared = 
+        q0->x * q0->x + q0->y * q0->y + q0->z * q0->z + q0->w * q0->w;
     
+    return quaternion_new(
+        -q0->x / length_squared,
+        -q0->y / length_squared,
+        -q0->z / length_squared,
+        q0->w / length_squared
+    );
 }
 
 
 Quaternion quaternion_negate(
     const Quaternion* q0
 ) {
-    
+    return quaternion_new(-q0->x, -q0->y, -q0->z, -q0->w);
 }
 
 
@@ -496,7 +1021,12 @@ Quaternion quaternion_difference(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
+    const Quaternion nearest_q0 = quaternion_dot(q0, q1) < 0
+        ? quaternion_negate(q0)
+        : *q0;
+    const Quaternion inverse_q0 = quaternion_inverse(&nearest_q0);
     
+    return quaternion_mul(&inverse_q0, q1);
 }
 
 
@@ -504,7 +1034,8 @@ float quaternion_distance(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    const Quaternion log_map = quaternion_log_map(q0, q1);
+    return 2.0f * quaternion_length(&log_map);
 }
 
 
@@ -512,7 +1043,9 @@ float quaternion_distance_sym(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    const Quaternion difference = quaternion_difference(q0, q1);
+    const Quaternion log = quaternion_log(&difference);
+    return 2.0f * quaternion_length(&log);
 }
 
 
@@ -520,7 +1053,7 @@ float quaternion_distance_chord(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    return 2.0f * sinf(quaternion_distance_sym(q0, q1) / 2.0f);
 }
 
 
@@ -528,7 +1061,9 @@ float quaternion_distance_abs(
     const Quaternion* q0,
     const Quaternion* q1
 ) {
-    
+    const Quaternion minus = quaternion_sub(q0, q1);
+    const Quaternion plus = quaternion_add(q0, q1);
+    return fminf(quaternion_length(&minus), quaternion_length(&plus));
 }
 
 
@@ -537,7 +1072,10 @@ Quaternion quaternion_slerp(
     const Quaternion* q1,
     const float alpha
 ) {
+    struct SlerpState slerp_state;
+    quaternion_slerp_function_init(q0, q1, &slerp_state);
     
+    return quaternion_slerp_function(&slerp_state, alpha);
 }
 
 
@@ -554,7 +1092,27 @@ void quaternion_slerp_function_init(
     const Quaternion* q1,
     struct SlerpState* out_slerp_state
 ) {
+    Quaternion unit_q0 = quaternion_normalize(q0);
+    const Quaternion unit_q1 = quaternion_normalize(q1);
+    
+    float dot = quaternion_dot(&unit_q0, &unit_q1);
+    if (dot < 0) {
+        unit_q0 = quaternion_negate(&unit_q0);
+        dot = -dot;
+    }
     
+    // A zero `sin_theta_0` selects linear interpolation for close endpoints.
+    const float theta_0 = dot < 1 ? acosf(dot) : 0.0f;
+    const struct SlerpState slerp_state = {
+        .q0 = unit_q0,
+        .q1 = unit_q1,
+        .dot = dot,
+        .theta_0 = theta_0,
+        .sin_theta_0 = sinf(theta_0)
+    };
+    
+    // The fields are const, so the state is copied in whole.
+    memcpy(out_slerp_state, &slerp_state, sizeof(slerp_state));
 }
 
 
@@ -562,7 +1120,25 @@ Quaternion quaternion_slerp_function(
     const struct SlerpState* slerp_state,
     const float alpha
 ) {
+    const Quaternion* q0 = &slerp_state->q0;
+    const Quaternion* q1 = &slerp_state->q1;
+    
+    if (slerp_state->sin_theta_0 == 0) {
+        const Quaternion delta = quaternion_sub(q1, q0);
+        const Quaternion scaled = quaternion_scale(&delta, alpha);
+        const Quaternion out = quaternion_add(q0, &scaled);
+        return quaternion_normalize(&out);
+    }
+    
+    const float theta = slerp_state->theta_0 * alpha;
+    const float sin_theta = sinf(theta);
+    const float s1 = sin_theta / slerp_state->sin_theta_0;
+    const float s0 = cosf(theta) - slerp_state->dot * s1;
     
+    const Quaternion scaled_q0 = quaternion_scale(q0, s0);
+    const Quaternion scaled_q1 = quaternion_scale(q1, s1);
+    const Quaternion out = quaternion_add(&scaled_q0, &scaled_q1);
+    return quaternion_normalize(&out);
 }
 
 
@@ -570,7 +1146,7 @@ size_t quaternion_get_intermediates_count(
     const size_t number,
     const int include_endpoints
 ) {
-    
+    return include_endpoints ? number + 2 : number;
 }
 
 
@@ -581,7 +1157,48 @@ void quaternion_intermediates(
     const int include_endpoints,
     Quaternion out_intermediates[]
 ) {
+    const float step_size = 1.0f / (float)(number + 1);
+    
+    struct SlerpState slerp_state;
+    quaternion_slerp_function_init(q0, q1, &slerp_state);
+    
+    size_t index = 0;
+    if (include_endpoints) {
+        out_intermediates[index++] = *q0;
+    }
+    for (size_t i = 1; i <= number; i++) {
+        out_intermediates[index++] = quaternion_slerp_function(
+            &slerp_state, step_size * (float) i
+        );
+    }
+    if (include_endpoints) {
+        out_intermediates[index] = *q1;
+    }
+}
+
+
+Quaternion* quaternion_intermediates_alloc(
+    const Quaternion* q0,
+    const Quaternion* q1,
+    const size_t number,
+    const int include_endpoints,
+    const Allocator* allocator,
+    size_t* out_count
+) {
+    const size_t count = quaternion_get_intermediates_count(
+        number, include_endpoints
+    );
+    Quaternion* intermediates = (Quaternion*) allocator_allocate(
+        allocator, count * sizeof(Quaternion), sizeof(Quaternion)
+    );
     
+    *out_count = intermediates ? count : 0;
+    if (intermediates) {
+        quaternion_intermediates(
+            q0, q1, number, include_endpoints, intermediates
+        );
+    }
+    return intermediates;
 }
 
 
@@ -589,7 +1206,10 @@ Quaternion quaternion_derivative(
     const Quaternion* q0,
     const Vector3* rate
 ) {
+    const Quaternion half_q0 = quaternion_scale(q0, 0.5f);
+    const Quaternion rate_quat = quaternion_from_vector(rate, 0.0f);
     
+    return quaternion_mul(&half_q0, &rate_quat);
 }
 
 
@@ -598,16 +1218,35 @@ Quaternion quaternion_integrate(
     const Vector3* rate,
     const float timestep
 ) {
+    const Quaternion unit_q0 = quaternion_normalize(q0);
+    
+    const Vector3 rotation_vector = vector3_scale(rate, timestep);
+    const float rotation_magnitude = vector3_magnitude(&rotation_vector);
+    if (rotation_magnitude > 0) {
+        const Vector3 axis = vector3_div(&rotation_vector, rotation_magnitude);
+        const Quaternion q1 = quaternion_from_axis_angle(&axis, rotation_magnitude);
+        const Quaternion out = quaternion_mul(&unit_q0, &q1);
+        return quaternion_normalize(&out);
+    }
     
+    return unit_q0;
 }
 
 
-Quaternion quaternion_angular_velocity(
+Vector3 quaternion_angular_velocity(
     const Quaternion* q0,
     const Quaternion* q1,
     const float timestep
 ) {
-    
+    if (timestep > 0) {
+        // Twice the vector part of the logarithm is the euler vector of the
+        // difference, without the loss of acos for small rotations.
+        const Quaternion difference = quaternion_difference(q0, q1);
+        const Quaternion log = quaternion_log(&difference);
+        const float scale = 2.0f / timestep;
+        return vector3_new(log.x * scale, log.y * scale, log.z * scale);
+    }
+    return VECTOR3_ZERO;
 }
 
 
@@ -631,7 +1270,7 @@ int quaternion_approx_eq(
 int quaternion_is_nan(
     const Quaternion* q0
 ) {
-    
+    return isnan(q0->x) || isnan(q0->y) || isnan(q0->z) || isnan(q0->w);
 }
 
 
@@ -664,14 +1303,29 @@ float quaternion_to_axis_angle(
     const Quaternion* q0,
     Vector3* out_axis
 ) {
+    const Quaternion unit_q0 = quaternion_normalize(q0);
+    const float w = fminf(fmaxf(unit_q0.w, -1.0f), 1.0f);
+    
+    const float angle = 2 * acosf(w);
+    const float s = sqrtf(1 - w * w);
     
+    if (s < EPSILON) {
+        *out_axis = vector3_new(unit_q0.x, unit_q0.y, unit_q0.z);
+    } else {
+        *out_axis = vector3_new(unit_q0.x / s, unit_q0.y / s, unit_q0.z / s);
+    }
+    
+    return angle;
 }
 
 
 Vector3 quaternion_to_euler_vector(
     const Quaternion* q0
 ) {
+    Vector3 axis;
+    const float angle = quaternion_to_axis_angle(q0, &axis);
     
+    return vector3_scale(&axis, angle);
 }
 
 
@@ -739,79 +1393,65 @@ Quaternion quaternion_imaginary(
 
 
 #define QUATERNION_NULL "NULL"
-#define QUATERNION_NULL_SIZE sizeof(QUATERNION_NULL)
 #define MAXIMUM_DECIMAL_PLACES 20
 #define QUATERNION_FORMAT_STRING_G "%.*g, %.*g, %.*g, %.*g"
 #define QUATERNION_FORMAT_STRING_F "%.*f, %.*f, %.*f, %.*f"
-#define QUATERNION_STRING_LENGTH (sizeof(QUATERNION_FORMAT_STRING_G) - (4 * 1))
+// Four "%.*f" floats, each at most a sign, 39 digits, a point and the
+// decimal places, the three separators and the terminator.
+#define QUATERNION_STRING_MAX_SIZE (4 * (41 + MAXIMUM_DECIMAL_PLACES) + 6 + 1)
 
 char* quaternion_to_string(
     const Quaternion* q0,
     const unsigned int decimal_places,
     const char formatter
 ) {
-    if (!q0) {
-        char* null_string = malloc(QUATERNION_NULL_SIZE);
-        if (!null_string) {
-            return NULL;
-        };
-        snprintf(null_string, QUATERNION_NULL_SIZE, QUATERNION_NULL);
-        return null_string;
-    }
-    
-    const unsigned int f_decimal_places = uint_min(
-        decimal_places, MAXIMUM_DECIMAL_PLACES
+    return quaternion_to_string_alloc(
+        q0, decimal_places, formatter, &ALLOCATOR_HEAP
     );
+}
+
+
+// Formatted on the stack first, so the output is one allocation of its
+// exact size.
+char* quaternion_to_string_alloc(
+    const Quaternion* q0,
+    const unsigned int decimal_places,
+    const char formatter,
+    const Allocator* allocator
+) {
+    char buffer[QUATERNION_STRING_MAX_SIZE];
+    int write_size;
     
-    const size_t buffer_size = 
-        QUATERNION_STRING_LENGTH + f_decimal_places * 4;
-    
-    char* buffer = (char*) malloc(buffer_size);
-    if (!buffer) {
-        return NULL;
-    }
-    
-    const char* format_string = formatter == 'f'
-        ? QUATERNION_FORMAT_STRING_F
-        : QUATERNION_FORMAT_STRING_G;
-    
-    int write_size = snprintf(
-        buffer, buffer_size, format_string,
-        f_decimal_places, q0->x, 
-        f_decimal_places, q0->y, 
-        f_decimal_places, q0->z, 
-        f_decimal_places, q0->w
-    );
-    
-    if (write_size < 0) {
-        free(buffer);
-        return NULL;
-    }
-    
-    if (write_size < buffer_size) {
-        return buffer;
+    if (!q0) {
+        write_size = snprintf(buffer, sizeof(buffer), QUATERNION_NULL);
+    } else {
+        const unsigned int f_decimal_places = uint_min(
+            decimal_places, MAXIMUM_DECIMAL_PLACES
+        );
+        
+        const char* format_string = formatter == 'f'
+            ? QUATERNION_FORMAT_STRING_F
+            : QUATERNION_FORMAT_STRING_G;
+        
+        write_size = snprintf(
+            buffer, sizeof(buffer), format_string,
+            f_decimal_places, q0->x, 
+            f_decimal_places, q0->y, 
+            f_decimal_places, q0->z, 
+            f_decimal_places, q0->w
+        );
     }
     
-    char* resized_buffer = realloc((void*) buffer, write_size + 1);
-    if (!resized_buffer) {
-        free(buffer);
+    if (write_size < 0 || (size_t) write_size >= sizeof(buffer)) {
         return NULL;
     }
-    buffer = resized_buffer;
-    
-    int rewrite_size = snprintf(
-        buffer, write_size + 1, format_string,
-        f_decimal_places, q0->x, 
-        f_decimal_places, q0->y, 
-        f_decimal_places, q0->z, 
-        f_decimal_places, q0->w
-    );
     
-    if ((rewrite_size < 0) || (rewrite_size >= (write_size + 1))) {
-        free(buffer);
+    char* string = (char*) allocator_allocate(allocator, write_size + 1, 1);
+    if (!string) {
         return NULL;
     }
     
-    return buffer;
+    memcpy(string, buffer, write_size + 1);
+    return string;
 }
 
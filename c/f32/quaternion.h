@@ -3,6 +3,7 @@
 #define QUATERNION_H
 
 #include <stddef.h>
+#include "allocator.h"
 #include "types.h"
 
 
@@ -248,6 +249,57 @@ Quaternion quaternion_log_map_sym(
     const Quaternion* q1
 );
 
+// Array versions of the above, with the transcendentals evaluated by the
+// vectorized simd_math functions. Results may differ from the single
+// versions by a few ulp. `out` may alias any input.
+
+void quaternion_exp_batch(
+    const Quaternion q0[],
+    const size_t count,
+    Quaternion out[]
+);
+
+void quaternion_log_batch(
+    const Quaternion q0[],
+    const size_t count,
+    Quaternion out[]
+);
+
+void quaternion_pow_batch(
+    const Quaternion q0[],
+    const size_t count,
+    const float pow,
+    Quaternion out[]
+);
+
+void quaternion_exp_map_batch(
+    const Quaternion q0[],
+    const Quaternion q1[],
+    const size_t count,
+    Quaternion out[]
+);
+
+void quaternion_exp_map_sym_batch(
+    const Quaternion q0[],
+    const Quaternion q1[],
+    const size_t count,
+    Quaternion out[]
+);
+
+void quaternion_log_map_batch(
+    const Quaternion q0[],
+    const Quaternion q1[],
+    const size_t count,
+    Quaternion out[]
+);
+
+void quaternion_log_map_sym_batch(
+    const Quaternion q0[],
+    const Quaternion q1[],
+    const size_t count,
+    Quaternion out[]
+);
+
 float quaternion_hypot(
     const Quaternion* q0
 );
@@ -256,6 +308,29 @@ Quaternion quaternion_normalize(
     const Quaternion* q0
 );
 
+// quaternion_normalize for any finite length, scaling by the largest
+// component first so that the squared length can neither overflow nor
+// underflow. Zero and non-finite quaternions become the identity.
+Quaternion quaternion_normalize_scaled(
+    const Quaternion* q0
+);
+
+// Normalizes an array. With SSE2, 1 / length comes from the hardware
+// reciprocal square root estimate refined by one Newton step, rather than
+// a square root and a divide; the length of each result is then within
+// 5e-7 of 1, and each component within 3e-7 of quaternion_normalize's.
+// Elements whose squared length is already within `tolerance` of 1 are
+// copied unchanged, so an array renormalized every tick is only rewritten
+// where it drifted; 0 normalizes every element. Lengths too small or large
+// to square are handled too, and zero or non-finite elements become the
+// identity. `out` may alias `q0`.
+void quaternion_normalize_batch(
+    const Quaternion q0[],
+    const size_t count,
+    const float tolerance,
+    Quaternion out[]
+);
+
 int quaternion_is_unit(
     const Quaternion* q0
 );
@@ -282,21 +357,26 @@ Quaternion quaternion_difference(
     const Quaternion* q1
 );
 
+// Geodesic distance, in [0, 2pi] for unit quaternions.
 float quaternion_distance(
     const Quaternion* q0,
     const Quaternion* q1
 );
 
+// Geodesic distance between the nearer of q0 and -q0 and q1, the angle of
+// the rotation between them, in [0, pi] for unit quaternions.
 float quaternion_distance_sym(
     const Quaternion* q0,
     const Quaternion* q1
 );
 
+// Length of the chord of the shortest arc, 2 sin(distance_sym / 2).
 float quaternion_distance_chord(
     const Quaternion* q0,
     const Quaternion* q1
 );
 
+// min(|q0 - q1|, |q0 + q1|).
 float quaternion_distance_abs(
     const Quaternion* q0,
     const Quaternion* q1
@@ -346,6 +426,17 @@ void quaternion_intermediates(
     Quaternion out_intermediates[]
 );
 
+// The same intermediates in an array from `allocator`, released with
+// allocator_release. Returns NULL if the allocation failed.
+Quaternion* quaternion_intermediates_alloc(
+    const Quaternion* q0,
+    const Quaternion* q1,
+    const size_t number,
+    const int include_endpoints,
+    const Allocator* allocator,
+    size_t* out_count
+);
+
 Quaternion quaternion_derivative(
     const Quaternion* q0,
     const Vector3* rate
@@ -357,7 +448,10 @@ Quaternion quaternion_integrate(
     const float timestep
 );
 
-Quaternion quaternion_angular_velocity(
+// Constant angular velocity, in the frame of q0, that rotates q0 to q1 in
+// `timestep`, so quaternion_integrate(q0, velocity, timestep) is q1. Zero
+// if `timestep` is not positive.
+Vector3 quaternion_angular_velocity(
     const Quaternion* q0,
     const Quaternion* q1,
     const float timestep
@@ -446,4 +540,14 @@ char* quaternion_to_string(
     const char formatter
 );
 
+// The same string from `allocator`, released with allocator_release. With
+// an Arena allocator, formatting many quaternions a frame makes no
+// allocator calls.
+char* quaternion_to_string_alloc(
+    const Quaternion* q0,
+    const unsigned int decimal_places,
+    const char formatter,
+    const Allocator* allocator
+);
+
 #endif
@@ -0,0 +1,336 @@
+#include "quaternion_average.h"
+
+#include <math.h>
+
+#include "quaternion.h"
+
+
+#define JACOBI_MAX_SWEEPS 16
+
+
+void quaternion_average_init(
+    QuaternionAverage* out_average
+) {
+    for (int i = 0; i < 10; i++) {
+        out_average->_m[i] = 0.0;
+    }
+    for (int i = 0; i < 4; i++) {
+        out_average->_sum[i] = 0.0;
+    }
+    out_average->_reference = QUATERNION_IDENTITY;
+    out_average->weight = 0.0;
+    out_average->count = 0;
+}
+
+
+void quaternion_average_add(
+    QuaternionAverage* self,
+    const Quaternion* sample,
+    const float weight
+) {
+    const double x = sample->x;
+    const double y = sample->y;
+    const double z = sample->z;
+    const double w = sample->w;
+    const double wx = weight * x;
+    const double wy = weight * y;
+    const double wz = weight * z;
+    const double ww = weight * w;
+    
+    double* m = self->_m;
+    m[0] += wx * x;
+    m[1] += wx * y;
+    m[2] += wx * z;
+    m[3] += wx * w;
+    m[4] += wy * y;
+    m[5] += wy * z;
+    m[6] += wy * w;
+    m[7] += wz * z;
+    m[8] += wz * w;
+    m[9] += ww * w;
+    
+    if (self->count == 0) {
+        self->_reference = *sample;
+    }
+    
+    const Quaternion* r = &self->_reference;
+    const float sign = (r->x * sample->x + r->y * sample->y
+        + r->z * sample->z + r->w * sample->w) < 0 ? -1.0f : 1.0f;
+    
+    self->_sum[0] += sign * wx;
+    self->_sum[1] += sign * wy;
+    self->_sum[2] += sign * wz;
+    self->_sum[3] += sign * ww;
+    
+    self->weight += weight;
+    self->count++;
+}
+
+
+void quaternion_average_add_array(
+    QuaternionAverage* self,
+    const Quaternion samples[],
+    const float weights[],
+    const size_t count
+) {
+    if (count == 0) {
+        return;
+    }
+    
+    if (self->count == 0) {
+        self->_reference = samples[0];
+    }
+    
+    const float rx = self->_reference.x;
+    const float ry = self->_reference.y;
+    const float rz = self->_reference.z;
+    const float rw = self->_reference.w;
+    
+    // Local accumulators keep the loop free of stores through `self`.
+    double m[10] = {0};
+    double sum[4] = {0};
+    double total = 0.0;
+    
+    for (size_t i = 0; i < count; i++) {
+        const double weight = weights ? weights[i] : 1.0;
+        const double x = samples[i].x;
+        const double y = samples[i].y;
+        const double z = samples[i].z;
+        const double w = samples[i].w;
+        const double wx = weight * x;
+        const double wy = weight * y;
+        const double wz = weight * z;
+        const double ww = weight * w;
+        
+        m[0] += wx * x;
+        m[1] += wx * y;
+        m[2] += wx * z;
+        m[3] += wx * w;
+        m[4] += wy * y;
+        m[5] += wy * z;
+        m[6] += wy * w;
+        m[7] += wz * z;
+        m[8] += wz * w;
+        m[9] += ww * w;
+        
+        const double sign = (rx * samples[i].x + ry * samples[i].y
+            + rz * samples[i].z + rw * samples[i].w) < 0 ? -1.0 : 1.0;
+        sum[0] += sign * wx;
+        sum[1] += sign * wy;
+        sum[2] += sign * wz;
+        sum[3] += sign * ww;
+        
+        total += weight;
+    }
+    
+    for (int i = 0; i < 10; i++) {
+        self->_m[i] += m[i];
+    }
+    for (int i = 0; i < 4; i++) {
+        self->_sum[i] += sum[i];
+    }
+    self->weight += total;
+    self->count += count;
+}
+
+
+void quaternion_average_merge(
+    QuaternionAverage* self,
+    const QuaternionAverage* other
+) {
+    if (other->count == 0) {
+        return;
+    }
+    
+    if (self->count == 0) {
+        *self = *other;
+        return;
+    }
+    
+    for (int i = 0; i < 10; i++) {
+        self->_m[i] += other->_m[i];
+    }
+    
+    // The other sum was aligned to a different reference sample.
+    const double dot = self->_sum[0] * other->_sum[0]
+        + self->_sum[1] * other->_sum[1]
+        + self->_sum[2] * other->_sum[2]
+        + self->_sum[3] * other->_sum[3];
+    const double sign = dot < 0 ? -1.0 : 1.0;
+    for (int i = 0; i < 4; i++) {
+        self->_sum[i] += sign * other->_sum[i];
+    }
+    
+    self->weight += other->weight;
+    self->count += other->count;
+}
+
+
+// Cyclic Jacobi eigenvalue iteration on the symmetric 4x4 matrix `a`,
+// returning the eigenvector of the largest eigenvalue. `a` is destroyed.
+static void largest_eigenvector(
+    double a[4][4],
+    double out[4]
+) {
+    double v[4][4] = {
+        {1, 0, 0, 0},
+        {0, 1, 0, 0},
+        {0, 0, 1, 0},
+        {0, 0, 0, 1}
+    };
+    
+    for (int sweep = 0; sweep < JACOBI_MAX_SWEEPS; sweep++) {
+        double off = 0.0;
+        double diag = 0.0;
+        for (int p = 0; p < 4; p++) {
+            diag += a[p][p] * a[p][p];
+            for (int q = p + 1; q < 4; q++) {
+                off += a[p][q] * a[p][q];
+            }
+        }
+        if (off <= 1e-30 * diag) {
+            break;
+        }
+        
+        for (int p = 0; p < 3; p++) {
+            for (int q = p + 1; q < 4; q++) {
+                const double apq = a[p][q];
+                if (apq == 0.0) {
+                    continue;
+                }
+                
+                const double theta = (a[q][q] - a[p][p]) / (2.0 * apq);
+                const double t = (theta >= 0 ? 1.0 : -1.0)
+                    / (fabs(theta) + sqrt(theta * theta + 1.0));
+                const double c = 1.0 / sqrt(t * t + 1.0);
+                const double s = t * c;
+                
+                for (int k = 0; k < 4; k++) {
+                    const double akp = a[k][p];
+                    const double akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < 4; k++) {
+                    const double apk = a[p][k];
+                    const double aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < 4; k++) {
+                    const double vkp = v[k][p];
+                    const double vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (a[i][i] > a[largest][largest]) {
+            largest = i;
+        }
+    }
+    
+    for (int i = 0; i < 4; i++) {
+        out[i] = v[i][largest];
+    }
+}
+
+
+Quaternion quaternion_average_finalize(
+    const QuaternionAverage* self
+) {
+    if (self->count == 0 || !(self->weight > 0)) {
+        return QUATERNION_IDENTITY;
+    }
+    
+    const double* m = self->_m;
+    double a[4][4] = {
+        {m[0], m[1], m[2], m[3]},
+        {m[1], m[4], m[5], m[6]},
+        {m[2], m[5], m[7], m[8]},
+        {m[3], m[6], m[8], m[9]}
+    };
+    
+    double e[4];
+    largest_eigenvector(a, e);
+    
+    // Pick the sign closest to the nlerp average so results are stable.
+    const double* sum = self->_sum;
+    if (e[0] * sum[0] + e[1] * sum[1] + e[2] * sum[2] + e[3] * sum[3] < 0) {
+        e[0] = -e[0];
+        e[1] = -e[1];
+        e[2] = -e[2];
+        e[3] = -e[3];
+    }
+    
+    const double length = sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2] + e[3] * e[3]);
+    
+    return quaternion_new(
+        (float)(e[0] / length),
+        (float)(e[1] / length),
+        (float)(e[2] / length),
+        (float)(e[3] / length)
+    );
+}
+
+
+Quaternion quaternion_average_nlerp(
+    const QuaternionAverage* self
+) {
+    const double* sum = self->_sum;
+    const double length = sqrt(
+        sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2] + sum[3] * sum[3]
+    );
+    
+    if (!(length > 0)) {
+        return QUATERNION_IDENTITY;
+    }
+    
+    return quaternion_new(
+        (float)(sum[0] / length),
+        (float)(sum[1] / length),
+        (float)(sum[2] / length),
+        (float)(sum[3] / length)
+    );
+}
+
+
+Quaternion quaternion_average_nlerp_array(
+    const Quaternion samples[],
+    const float weights[],
+    const size_t count
+) {
+    if (count == 0) {
+        return QUATERNION_IDENTITY;
+    }
+    
+    const Quaternion reference = samples[0];
+    float sx = 0.0f;
+    float sy = 0.0f;
+    float sz = 0.0f;
+    float sw = 0.0f;
+    
+    for (size_t i = 0; i < count; i++) {
+        const Quaternion* q = &samples[i];
+        const float dot = reference.x * q->x + reference.y * q->y
+            + reference.z * q->z + reference.w * q->w;
+        const float weight = weights ? weights[i] : 1.0f;
+        const float signed_weight = dot < 0 ? -weight : weight;
+        
+        sx += signed_weight * q->x;
+        sy += signed_weight * q->y;
+        sz += signed_weight * q->z;
+        sw += signed_weight * q->w;
+    }
+    
+    const float length = sqrtf(sx * sx + sy * sy + sz * sz + sw * sw);
+    if (!(length > 0)) {
+        return QUATERNION_IDENTITY;
+    }
+    
+    return quaternion_new(sx / length, sy / length, sz / length, sw / length);
+}
@@ -0,0 +1,66 @@
+#ifndef QUATERNION_AVERAGE_H
+#define QUATERNION_AVERAGE_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Weighted quaternion averaging using Markley's method: the average is the
+// eigenvector with the largest eigenvalue of M = sum(w * q * q^T).
+// Samples can be streamed in any order and accumulators from different
+// threads can be merged before finalizing.
+//
+// Never write to struct fields directly.
+
+typedef struct QuaternionAverage {
+    // Upper triangle of M, row major: xx xy xz xw yy yz yw zz zw ww
+    double _m[10];
+    // Sign aligned weighted sum, used by the nlerp average.
+    double _sum[4];
+    Quaternion _reference;
+    double weight;
+    size_t count;
+} QuaternionAverage;
+
+
+void quaternion_average_init(
+    QuaternionAverage* out_average
+);
+
+void quaternion_average_add(
+    QuaternionAverage* self,
+    const Quaternion* sample,
+    const float weight
+);
+
+// `weights` is optional, every sample has a weight of 1 if it is NULL.
+void quaternion_average_add_array(
+    QuaternionAverage* self,
+    const Quaternion samples[],
+    const float weights[],
+    const size_t count
+);
+
+void quaternion_average_merge(
+    QuaternionAverage* self,
+    const QuaternionAverage* other
+);
+
+// Returns the identity if no samples with a positive weight were added.
+Quaternion quaternion_average_finalize(
+    const QuaternionAverage* self
+);
+
+// Normalized weighted sum of the samples, with each sample flipped into the
+// same hemisphere as the first one. Only accurate for tightly clustered
+// samples, but avoids the eigen solve.
+Quaternion quaternion_average_nlerp(
+    const QuaternionAverage* self
+);
+
+Quaternion quaternion_average_nlerp_array(
+    const Quaternion samples[],
+    const float weights[],
+    const size_t count
+);
+
+#endif
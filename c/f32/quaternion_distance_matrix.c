@@ -0,0 +1,522 @@
+#include "quaternion_distance_matrix.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+#include "simd_math.h"
+
+
+// Columns per tile, 4 KB of components.
+#define TILE_COLUMNS 256
+// Rows run against a tile before moving on to the next.
+#define BLOCK_ROWS 32
+#define MAX_THREADS 64
+
+
+// Components of up to TILE_COLUMNS quaternions, one array each.
+typedef struct Tile {
+    float x[TILE_COLUMNS];
+    float y[TILE_COLUMNS];
+    float z[TILE_COLUMNS];
+    float w[TILE_COLUMNS];
+    size_t count;
+} Tile;
+
+typedef struct MatrixJob {
+    const Quaternion* q0;
+    size_t count0;
+    const Quaternion* q1;
+    size_t count1;
+    QuaternionDistanceMetric metric;
+    size_t k;
+    float* out;
+    size_t* out_indices;
+    size_t tile_count;
+    size_t item_count;
+    // Index of the next work item to hand out.
+    size_t next;
+} MatrixJob;
+
+
+static void load_tile(
+    Tile* out_tile,
+    const Quaternion q[],
+    const size_t count
+) {
+    for (size_t i = 0; i < count; i++) {
+        out_tile->x[i] = q[i].x;
+        out_tile->y[i] = q[i].y;
+        out_tile->z[i] = q[i].z;
+        out_tile->w[i] = q[i].w;
+    }
+    out_tile->count = count;
+}
+
+
+// |q0 - q1|^2 and |q0 + q1|^2.
+static inline void pair_lengths(
+    const Quaternion* q0,
+    const float x1,
+    const float y1,
+    const float z1,
+    const float w1,
+    float* out_minus,
+    float* out_plus
+) {
+    const float dx = q0->x - x1;
+    const float dy = q0->y - y1;
+    const float dz = q0->z - z1;
+    const float dw = q0->w - w1;
+    const float sx = q0->x + x1;
+    const float sy = q0->y + y1;
+    const float sz = q0->z + z1;
+    const float sw = q0->w + w1;
+    *out_minus = dx * dx + dy * dy + dz * dz + dw * dw;
+    *out_plus = sx * sx + sy * sy + sz * sz + sw * sw;
+}
+
+
+// From minus = |q0 - q1|^2 and plus = |q0 + q1|^2, either the key that
+// orders the metric, or the metric's value for CHORD and ABS, or the
+// arguments of the atan2 that gives a quarter of it for the others.
+static inline void finish_scalar(
+    const float minus,
+    const float plus,
+    const QuaternionDistanceMetric metric,
+    const int keys,
+    float* out_y,
+    float* out_x
+) {
+    const float nearer = fminf(minus, plus);
+    
+    if (keys) {
+        *out_y = metric == QUATERNION_DISTANCE ? minus : nearer;
+        return;
+    }
+    
+    switch (metric) {
+        case QUATERNION_DISTANCE:
+            *out_y = sqrtf(minus);
+            *out_x = sqrtf(plus);
+            break;
+        case QUATERNION_DISTANCE_SYM:
+            *out_y = sqrtf(nearer);
+            *out_x = sqrtf(fmaxf(minus, plus));
+            break;
+        case QUATERNION_DISTANCE_CHORD:
+            *out_y = sqrtf(minus * plus);
+            break;
+        case QUATERNION_DISTANCE_ABS:
+            *out_y = sqrtf(nearer);
+            break;
+    }
+}
+
+
+// finish_scalar for every column of the tile against q0. `out_x` is only
+// written for DISTANCE and SYM when not computing keys.
+static void pair_kernel(
+    const Quaternion* q0,
+    const Tile* tile,
+    const QuaternionDistanceMetric metric,
+    const int keys,
+    float out_y[],
+    float out_x[]
+) {
+    size_t j = 0;
+
+#if defined(__SSE2__)
+    const __m128 x0 = _mm_set1_ps(q0->x);
+    const __m128 y0 = _mm_set1_ps(q0->y);
+    const __m128 z0 = _mm_set1_ps(q0->z);
+    const __m128 w0 = _mm_set1_ps(q0->w);
+    
+    for (; j + 4 <= tile->count; j += 4) {
+        const __m128 x1 = _mm_loadu_ps(&(tile->x[j]));
+        const __m128 y1 = _mm_loadu_ps(&(tile->y[j]));
+        const __m128 z1 = _mm_loadu_ps(&(tile->z[j]));
+        const __m128 w1 = _mm_loadu_ps(&(tile->w[j]));
+        
+        const __m128 dx = _mm_sub_ps(x0, x1);
+        const __m128 dy = _mm_sub_ps(y0, y1);
+        const __m128 dz = _mm_sub_ps(z0, z1);
+        const __m128 dw = _mm_sub_ps(w0, w1);
+        const __m128 minus = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+            _mm_add_ps(_mm_mul_ps(dz, dz), _mm_mul_ps(dw, dw))
+        );
+        
+        const __m128 sx = _mm_add_ps(x0, x1);
+        const __m128 sy = _mm_add_ps(y0, y1);
+        const __m128 sz = _mm_add_ps(z0, z1);
+        const __m128 sw = _mm_add_ps(w0, w1);
+        const __m128 plus = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy)),
+            _mm_add_ps(_mm_mul_ps(sz, sz), _mm_mul_ps(sw, sw))
+        );
+        
+        const __m128 nearer = _mm_min_ps(minus, plus);
+        
+        if (keys) {
+            _mm_storeu_ps(
+                &(out_y[j]), metric == QUATERNION_DISTANCE ? minus : nearer
+            );
+            continue;
+        }
+        
+        switch (metric) {
+            case QUATERNION_DISTANCE:
+                _mm_storeu_ps(&(out_y[j]), _mm_sqrt_ps(minus));
+                _mm_storeu_ps(&(out_x[j]), _mm_sqrt_ps(plus));
+                break;
+            case QUATERNION_DISTANCE_SYM:
+                _mm_storeu_ps(&(out_y[j]), _mm_sqrt_ps(nearer));
+                _mm_storeu_ps(
+                    &(out_x[j]), _mm_sqrt_ps(_mm_max_ps(minus, plus))
+                );
+                break;
+            case QUATERNION_DISTANCE_CHORD:
+                _mm_storeu_ps(
+                    &(out_y[j]), _mm_sqrt_ps(_mm_mul_ps(minus, plus))
+                );
+                break;
+            case QUATERNION_DISTANCE_ABS:
+                _mm_storeu_ps(&(out_y[j]), _mm_sqrt_ps(nearer));
+                break;
+        }
+    }
+#endif
+
+    for (; j < tile->count; j++) {
+        float minus;
+        float plus;
+        pair_lengths(
+            q0, tile->x[j], tile->y[j], tile->z[j], tile->w[j], &minus, &plus
+        );
+        
+        float unused;
+        finish_scalar(
+            minus, plus, metric, keys, &(out_y[j]), out_x ? &(out_x[j]) : &unused
+        );
+    }
+}
+
+
+// The distances from q0 to every column of the tile.
+static void evaluate_row(
+    const Quaternion* q0,
+    const Tile* tile,
+    const QuaternionDistanceMetric metric,
+    float out[]
+) {
+    if (metric == QUATERNION_DISTANCE_CHORD || metric == QUATERNION_DISTANCE_ABS) {
+        pair_kernel(q0, tile, metric, 0, out, NULL);
+        return;
+    }
+    
+    float y[TILE_COLUMNS];
+    float x[TILE_COLUMNS];
+    pair_kernel(q0, tile, metric, 0, y, x);
+    simd_atan2(y, x, tile->count, out, SIMD_MATH_PRECISE);
+    for (size_t j = 0; j < tile->count; j++) {
+        out[j] *= 4.0f;
+    }
+}
+
+
+static float pair_distance(
+    const Quaternion* q0,
+    const Quaternion* q1,
+    const QuaternionDistanceMetric metric
+) {
+    float minus;
+    float plus;
+    pair_lengths(q0, q1->x, q1->y, q1->z, q1->w, &minus, &plus);
+    
+    float y = 0.0f;
+    float x = 0.0f;
+    finish_scalar(minus, plus, metric, 0, &y, &x);
+    
+    if (metric == QUATERNION_DISTANCE_CHORD || metric == QUATERNION_DISTANCE_ABS) {
+        return y;
+    }
+    return 4.0f * atan2f(y, x);
+}
+
+
+// Inserts the key into the sorted keys of a row, which hold `filled` of at
+// most k, after any equal keys. When full, the key must be less than the
+// last, which is dropped.
+static void insert_nearest(
+    float keys[],
+    size_t indices[],
+    size_t* filled,
+    const size_t k,
+    const float key,
+    const size_t index
+) {
+    size_t position = *filled < k ? (*filled)++ : k - 1;
+    while (position > 0 && keys[position - 1] > key) {
+        keys[position] = keys[position - 1];
+        indices[position] = indices[position - 1];
+        position--;
+    }
+    keys[position] = key;
+    indices[position] = index;
+}
+
+
+// Inserts the keys of a tile, whose first column is `first_column`, that
+// are among the k nearest so far. Most are not once the row has filled, so
+// they are compared with the last four at a time.
+static void select_nearest(
+    const float keys[],
+    const size_t count,
+    const size_t first_column,
+    const size_t k,
+    float row_keys[],
+    size_t row_indices[],
+    size_t* filled
+) {
+    float threshold = *filled < k ? INFINITY : row_keys[k - 1];
+    size_t j = 0;
+
+#if defined(__SSE2__)
+    for (; j + 4 <= count; j += 4) {
+        int nearer = _mm_movemask_ps(
+            _mm_cmplt_ps(_mm_loadu_ps(&(keys[j])), _mm_set1_ps(threshold))
+        );
+        while (nearer) {
+            const int lane = __builtin_ctz((unsigned int) nearer);
+            nearer &= nearer - 1;
+            
+            // The threshold may have dropped since the compare.
+            if (keys[j + lane] < threshold) {
+                insert_nearest(
+                    row_keys, row_indices, filled, k,
+                    keys[j + lane], first_column + j + lane
+                );
+                threshold = *filled < k ? INFINITY : row_keys[k - 1];
+            }
+        }
+    }
+#endif
+
+    for (; j < count; j++) {
+        if (keys[j] < threshold) {
+            insert_nearest(
+                row_keys, row_indices, filled, k, keys[j], first_column + j
+            );
+            threshold = *filled < k ? INFINITY : row_keys[k - 1];
+        }
+    }
+}
+
+
+static void* matrix_worker(
+    void* argument
+) {
+    MatrixJob* job = (MatrixJob*) argument;
+    Tile tile;
+    
+    for (;;) {
+        const size_t item = __atomic_fetch_add(
+            &(job->next), 1, __ATOMIC_RELAXED
+        );
+        if (item >= job->item_count) {
+            break;
+        }
+        
+        const size_t first_row = item / job->tile_count * BLOCK_ROWS;
+        const size_t first_column = item % job->tile_count * TILE_COLUMNS;
+        const size_t remaining_rows = job->count0 - first_row;
+        const size_t rows = remaining_rows < BLOCK_ROWS
+            ? remaining_rows
+            : BLOCK_ROWS;
+        const size_t remaining_columns = job->count1 - first_column;
+        const size_t columns = remaining_columns < TILE_COLUMNS
+            ? remaining_columns
+            : TILE_COLUMNS;
+        
+        load_tile(&tile, &(job->q1[first_column]), columns);
+        for (size_t i = first_row; i < first_row + rows; i++) {
+            evaluate_row(
+                &(job->q0[i]),
+                &tile,
+                job->metric,
+                &(job->out[i * job->count1 + first_column])
+            );
+        }
+    }
+    
+    return NULL;
+}
+
+
+static void* top_k_worker(
+    void* argument
+) {
+    MatrixJob* job = (MatrixJob*) argument;
+    const size_t k = job->k;
+    Tile tile;
+    float keys[TILE_COLUMNS];
+    size_t filled[BLOCK_ROWS];
+    
+    for (;;) {
+        const size_t item = __atomic_fetch_add(
+            &(job->next), 1, __ATOMIC_RELAXED
+        );
+        if (item >= job->item_count) {
+            break;
+        }
+        
+        const size_t first_row = item * BLOCK_ROWS;
+        const size_t remaining_rows = job->count0 - first_row;
+        const size_t rows = remaining_rows < BLOCK_ROWS
+            ? remaining_rows
+            : BLOCK_ROWS;
+        
+        for (size_t r = 0; r < rows; r++) {
+            filled[r] = 0;
+        }
+        
+        // The rows keep their keys in their part of the output until the
+        // distances of the nearest are evaluated.
+        for (size_t t = 0; t < job->tile_count; t++) {
+            const size_t first_column = t * TILE_COLUMNS;
+            const size_t remaining_columns = job->count1 - first_column;
+            const size_t columns = remaining_columns < TILE_COLUMNS
+                ? remaining_columns
+                : TILE_COLUMNS;
+            load_tile(&tile, &(job->q1[first_column]), columns);
+            
+            for (size_t r = 0; r < rows; r++) {
+                float* row_keys = &(job->out[(first_row + r) * k]);
+                size_t* row_indices = &(job->out_indices[(first_row + r) * k]);
+                
+                pair_kernel(
+                    &(job->q0[first_row + r]), &tile, job->metric, 1, keys, NULL
+                );
+                
+                select_nearest(
+                    keys, columns, first_column, k,
+                    row_keys, row_indices, &(filled[r])
+                );
+            }
+        }
+        
+        for (size_t r = 0; r < rows; r++) {
+            const size_t i = first_row + r;
+            for (size_t j = 0; j < k; j++) {
+                if (j < filled[r]) {
+                    job->out[i * k + j] = pair_distance(
+                        &(job->q0[i]),
+                        &(job->q1[job->out_indices[i * k + j]]),
+                        job->metric
+                    );
+                } else {
+                    job->out[i * k + j] = INFINITY;
+                    job->out_indices[i * k + j] = SIZE_MAX;
+                }
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+
+// Runs the job's work items on `thread_count` threads including this one.
+static void run_job(
+    MatrixJob* job,
+    void* (*worker)(void*),
+    const size_t thread_count
+) {
+    size_t helper_count = thread_count < job->item_count
+        ? thread_count
+        : job->item_count;
+    helper_count = helper_count > MAX_THREADS ? MAX_THREADS : helper_count;
+    helper_count = helper_count > 0 ? helper_count - 1 : 0;
+    
+    pthread_t helpers[MAX_THREADS];
+    size_t started = 0;
+    while (started < helper_count) {
+        if (pthread_create(&(helpers[started]), NULL, worker, job) != 0) {
+            break;
+        }
+        started++;
+    }
+    
+    worker(job);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(helpers[i], NULL);
+    }
+}
+
+
+void quaternion_distance_matrix(
+    const Quaternion q0[],
+    const size_t count0,
+    const Quaternion q1[],
+    const size_t count1,
+    const QuaternionDistanceMetric metric,
+    const size_t thread_count,
+    float out[]
+) {
+    const size_t row_blocks = (count0 + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    const size_t tile_count = (count1 + TILE_COLUMNS - 1) / TILE_COLUMNS;
+    
+    MatrixJob job = {
+        .q0 = q0,
+        .count0 = count0,
+        .q1 = q1,
+        .count1 = count1,
+        .metric = metric,
+        .k = 0,
+        .out = out,
+        .out_indices = NULL,
+        .tile_count = tile_count,
+        .item_count = row_blocks * tile_count,
+        .next = 0
+    };
+    
+    run_job(&job, matrix_worker, thread_count);
+}
+
+
+void quaternion_distance_top_k(
+    const Quaternion q0[],
+    const size_t count0,
+    const Quaternion q1[],
+    const size_t count1,
+    const QuaternionDistanceMetric metric,
+    const size_t k,
+    const size_t thread_count,
+    float out_distances[],
+    size_t out_indices[]
+) {
+    if (k == 0) {
+        return;
+    }
+    
+    MatrixJob job = {
+        .q0 = q0,
+        .count0 = count0,
+        .q1 = q1,
+        .count1 = count1,
+        .metric = metric,
+        .k = k,
+        .out = out_distances,
+        .out_indices = out_indices,
+        .tile_count = (count1 + TILE_COLUMNS - 1) / TILE_COLUMNS,
+        .item_count = (count0 + BLOCK_ROWS - 1) / BLOCK_ROWS,
+        .next = 0
+    };
+    
+    run_job(&job, top_k_worker, thread_count);
+}
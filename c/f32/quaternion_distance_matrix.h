@@ -0,0 +1,64 @@
+#ifndef QUATERNION_DISTANCE_MATRIX_H
+#define QUATERNION_DISTANCE_MATRIX_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Distances between every pair of two sets of unit quaternions, for
+// clustering and pose matching over large motion databases.
+//
+// Every metric is computed from |q0 - q1| and |q0 + q1|, which for unit
+// quaternions are 2 sin(a / 4) and 2 cos(a / 4) of the geodesic distance
+// a. Those cost an add and a multiply-add per component more than the dot
+// product, but keep small distances accurate, where the arc cosine of the
+// dot product cannot resolve distances below about 7e-4 radians.
+//
+// The second set is transposed into tiles that stay in L1 while blocks of
+// rows of the first set are run against them, four pairs at a time with
+// SSE2, and the tiles are spread over threads. For unit quaternions the
+// results agree with the single quaternion_distance functions to about
+// 1e-6; for other inputs they are not meaningful.
+
+typedef enum QuaternionDistanceMetric {
+    // quaternion_distance, in [0, 2pi].
+    QUATERNION_DISTANCE,
+    // quaternion_distance_sym, in [0, pi].
+    QUATERNION_DISTANCE_SYM,
+    // quaternion_distance_chord, in [0, 2].
+    QUATERNION_DISTANCE_CHORD,
+    // quaternion_distance_abs, in [0, sqrt(2)].
+    QUATERNION_DISTANCE_ABS
+} QuaternionDistanceMetric;
+
+
+// Writes the distance from q0[i] to q1[j] to out[i * count1 + j], using
+// `thread_count` threads including the calling one. If a thread cannot be
+// started, the remaining threads take over its share.
+void quaternion_distance_matrix(
+    const Quaternion q0[],
+    const size_t count0,
+    const Quaternion q1[],
+    const size_t count1,
+    const QuaternionDistanceMetric metric,
+    const size_t thread_count,
+    float out[]
+);
+
+// The `k` nearest elements of q1 to each element of q0: row i of
+// out_distances and out_indices, starting at i * k, holds them in order of
+// increasing distance, ties in order of index. Only the distances of the
+// nearest are evaluated, since every metric increases with a cheaper key.
+// Rows are padded with INFINITY and SIZE_MAX if k is more than count1.
+void quaternion_distance_top_k(
+    const Quaternion q0[],
+    const size_t count0,
+    const Quaternion q1[],
+    const size_t count1,
+    const QuaternionDistanceMetric metric,
+    const size_t k,
+    const size_t thread_count,
+    float out_distances[],
+    size_t out_indices[]
+);
+
+#endif
@@ -0,0 +1,308 @@
+#include "quaternion_integrator.h"
+
+#include <math.h>
+
+#include "quaternion.h"
+#include "simd_math.h"
+
+
+// Below this half angle the series expansions are exact to float precision.
+#define SMALL_HALF_ANGLE 1e-2f
+
+#define BATCH_BLOCK_SIZE 64
+
+
+// q * (rotation * sinc, c), with sinc = sin(h) / (2h) and c = cos(h) for
+// the half angle h of the rotation vector.
+static inline Quaternion rotate_by_half_angle(
+    const Quaternion* q0,
+    const float rx,
+    const float ry,
+    const float rz,
+    const float sinc,
+    const float c
+) {
+    const Quaternion dq = quaternion_new(rx * sinc, ry * sinc, rz * sinc, c);
+    return quaternion_mul(q0, &dq);
+}
+
+
+// q * exp(rotation / 2), where `rotation` is a rotation vector.
+static inline Quaternion rotate_by_vector(
+    const Quaternion* q0,
+    const float rx,
+    const float ry,
+    const float rz
+) {
+    const float angle_squared = rx * rx + ry * ry + rz * rz;
+    const float half_squared = 0.25f * angle_squared;
+    
+    float sinc, c;
+    if (half_squared < SMALL_HALF_ANGLE * SMALL_HALF_ANGLE) {
+        sinc = 0.5f * (1.0f - half_squared * (1.0f / 6.0f));
+        c = 1.0f - half_squared * (0.5f - half_squared * (1.0f / 24.0f));
+    } else {
+        const float angle = sqrtf(angle_squared);
+        const float half = 0.5f * angle;
+        sinc = sinf(half) / angle;
+        c = cosf(half);
+    }
+    
+    return rotate_by_half_angle(q0, rx, ry, rz, sinc, c);
+}
+
+
+// rotate_by_vector for a block of at most BATCH_BLOCK_SIZE orientations,
+// with the sines and cosines evaluated together by simd_sincos. `out` may
+// be `q`.
+static void rotate_by_vectors(
+    const Quaternion q[],
+    const float rx[],
+    const float ry[],
+    const float rz[],
+    const size_t count,
+    Quaternion out[]
+) {
+    float halves[BATCH_BLOCK_SIZE];
+    float sines[BATCH_BLOCK_SIZE];
+    float cosines[BATCH_BLOCK_SIZE];
+    
+    for (size_t i = 0; i < count; i++) {
+        halves[i] = 0.5f * sqrtf(rx[i] * rx[i] + ry[i] * ry[i] + rz[i] * rz[i]);
+    }
+    
+    simd_sincos(halves, count, sines, cosines, SIMD_MATH_PRECISE);
+    
+    for (size_t i = 0; i < count; i++) {
+        const float half = halves[i];
+        if (half < SMALL_HALF_ANGLE) {
+            out[i] = rotate_by_vector(&(q[i]), rx[i], ry[i], rz[i]);
+        } else {
+            out[i] = rotate_by_half_angle(
+                &(q[i]), rx[i], ry[i], rz[i],
+                sines[i] / (2.0f * half), cosines[i]
+            );
+        }
+    }
+}
+
+
+Quaternion quaternion_integrate_exp(
+    const Quaternion* q0,
+    const Vector3* rate,
+    const float timestep
+) {
+    return rotate_by_vector(
+        q0, rate->x * timestep, rate->y * timestep, rate->z * timestep
+    );
+}
+
+
+// 0.5 * q * (rate, 0)
+static inline Quaternion derivative(
+    const Quaternion* q0,
+    const float rx,
+    const float ry,
+    const float rz
+) {
+    return quaternion_new(
+        0.5f * (q0->w * rx + q0->y * rz - q0->z * ry),
+        0.5f * (q0->w * ry - q0->x * rz + q0->z * rx),
+        0.5f * (q0->w * rz + q0->x * ry - q0->y * rx),
+        0.5f * (-q0->x * rx - q0->y * ry - q0->z * rz)
+    );
+}
+
+
+static inline Quaternion add_scaled(
+    const Quaternion* q0,
+    const Quaternion* q1,
+    const float scale
+) {
+    return quaternion_new(
+        q0->x + q1->x * scale,
+        q0->y + q1->y * scale,
+        q0->z + q1->z * scale,
+        q0->w + q1->w * scale
+    );
+}
+
+
+// One RK4 step, before renormalizing.
+static inline Quaternion rk4_step(
+    const Quaternion* q0,
+    const Vector3* rate_start,
+    const Vector3* rate_end,
+    const float timestep
+) {
+    const float half_dt = 0.5f * timestep;
+    const float mx = 0.5f * (rate_start->x + rate_end->x);
+    const float my = 0.5f * (rate_start->y + rate_end->y);
+    const float mz = 0.5f * (rate_start->z + rate_end->z);
+    
+    const Quaternion k1 = derivative(q0, rate_start->x, rate_start->y, rate_start->z);
+    const Quaternion q1 = add_scaled(q0, &k1, half_dt);
+    const Quaternion k2 = derivative(&q1, mx, my, mz);
+    const Quaternion q2 = add_scaled(q0, &k2, half_dt);
+    const Quaternion k3 = derivative(&q2, mx, my, mz);
+    const Quaternion q3 = add_scaled(q0, &k3, timestep);
+    const Quaternion k4 = derivative(&q3, rate_end->x, rate_end->y, rate_end->z);
+    
+    const float sixth_dt = timestep * (1.0f / 6.0f);
+    return quaternion_new(
+        q0->x + sixth_dt * (k1.x + 2.0f * (k2.x + k3.x) + k4.x),
+        q0->y + sixth_dt * (k1.y + 2.0f * (k2.y + k3.y) + k4.y),
+        q0->z + sixth_dt * (k1.z + 2.0f * (k2.z + k3.z) + k4.z),
+        q0->w + sixth_dt * (k1.w + 2.0f * (k2.w + k3.w) + k4.w)
+    );
+}
+
+
+Quaternion quaternion_integrate_rk4(
+    const Quaternion* q0,
+    const Vector3* rate_start,
+    const Vector3* rate_end,
+    const float timestep
+) {
+    const Quaternion out = rk4_step(q0, rate_start, rate_end, timestep);
+    return quaternion_normalize(&out);
+}
+
+
+// The single rotation vector of consecutive increments, with the coning
+// correction.
+static inline void coning_rotation(
+    const Vector3 increments[],
+    const size_t increment_count,
+    float* out_x,
+    float* out_y,
+    float* out_z
+) {
+    // Running sum of increments, and the accumulated coning correction.
+    float ax = 0.0f, ay = 0.0f, az = 0.0f;
+    float cx = 0.0f, cy = 0.0f, cz = 0.0f;
+    
+    for (size_t i = 0; i < increment_count; i++) {
+        const float dx = increments[i].x;
+        const float dy = increments[i].y;
+        const float dz = increments[i].z;
+        
+        cx += ay * dz - az * dy;
+        cy += az * dx - ax * dz;
+        cz += ax * dy - ay * dx;
+        
+        ax += dx;
+        ay += dy;
+        az += dz;
+    }
+    
+    *out_x = ax + 0.5f * cx;
+    *out_y = ay + 0.5f * cy;
+    *out_z = az + 0.5f * cz;
+}
+
+
+Quaternion quaternion_integrate_coning(
+    const Quaternion* q0,
+    const Vector3 increments[],
+    const size_t increment_count
+) {
+    float rx, ry, rz;
+    coning_rotation(increments, increment_count, &rx, &ry, &rz);
+    return rotate_by_vector(q0, rx, ry, rz);
+}
+
+
+void quaternion_integrate_exp_array(
+    const Quaternion q[],
+    const Vector3 rates[],
+    const float timestep,
+    const size_t count,
+    Quaternion out[]
+) {
+    float rx[BATCH_BLOCK_SIZE];
+    float ry[BATCH_BLOCK_SIZE];
+    float rz[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            rx[i] = rates[start + i].x * timestep;
+            ry[i] = rates[start + i].y * timestep;
+            rz[i] = rates[start + i].z * timestep;
+        }
+        
+        rotate_by_vectors(&(q[start]), rx, ry, rz, block, &(out[start]));
+    }
+}
+
+
+void quaternion_integrate_rk4_array(
+    const Quaternion q[],
+    const Vector3 rates_start[],
+    const Vector3 rates_end[],
+    const float timestep,
+    const size_t count,
+    Quaternion out[]
+) {
+    float inv_lengths[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            const size_t index = start + i;
+            const Quaternion step = rk4_step(
+                &q[index], &rates_start[index], &rates_end[index], timestep
+            );
+            out[index] = step;
+            inv_lengths[i] = step.x * step.x + step.y * step.y
+                + step.z * step.z + step.w * step.w;
+        }
+        
+        simd_rsqrt(inv_lengths, block, inv_lengths, SIMD_MATH_PRECISE);
+        
+        for (size_t i = 0; i < block; i++) {
+            const size_t index = start + i;
+            out[index] = inv_lengths[i] > 0 && inv_lengths[i] < HUGE_VALF
+                ? quaternion_scale(&(out[index]), inv_lengths[i])
+                : QUATERNION_IDENTITY;
+        }
+    }
+}
+
+
+void quaternion_integrate_coning_array(
+    const Quaternion q[],
+    const Vector3 increments[],
+    const size_t increment_count,
+    const size_t count,
+    Quaternion out[]
+) {
+    float rx[BATCH_BLOCK_SIZE];
+    float ry[BATCH_BLOCK_SIZE];
+    float rz[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            coning_rotation(
+                &increments[(start + i) * increment_count], increment_count,
+                &(rx[i]), &(ry[i]), &(rz[i])
+            );
+        }
+        
+        rotate_by_vectors(&(q[start]), rx, ry, rz, block, &(out[start]));
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef QUATERNION_INTEGRATOR_H
+#define QUATERNION_INTEGRATOR_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Orientation integrators for body frame angular rates, as used by
+// quaternion_integrate. Orientations are expected to be unit quaternions.
+//
+// The `_array` variants integrate `count` independent orientations, and
+// `out` may be the same array as `q`. They evaluate the sines and cosines
+// with simd_sincos, and the reciprocal lengths with simd_rsqrt, so results
+// may differ from the single versions by a few ulp.
+
+
+// Exact for a constant rate over the timestep: q * exp(rate * timestep / 2).
+// Stays unit length without renormalization, and uses a series expansion
+// for small angles instead of dividing by the rotation magnitude.
+Quaternion quaternion_integrate_exp(
+    const Quaternion* q0,
+    const Vector3* rate,
+    const float timestep
+);
+
+// Fourth order Runge-Kutta on the quaternion derivative, with the rate
+// varying linearly from `rate_start` to `rate_end` over the timestep.
+Quaternion quaternion_integrate_rk4(
+    const Quaternion* q0,
+    const Vector3* rate_start,
+    const Vector3* rate_end,
+    const float timestep
+);
+
+// Integrates consecutive gyro angle increments (rate integrated over each
+// sample period) as a single rotation, adding the first order coning
+// correction 0.5 * sum(alpha_before_i x increment_i).
+Quaternion quaternion_integrate_coning(
+    const Quaternion* q0,
+    const Vector3 increments[],
+    const size_t increment_count
+);
+
+
+void quaternion_integrate_exp_array(
+    const Quaternion q[],
+    const Vector3 rates[],
+    const float timestep,
+    const size_t count,
+    Quaternion out[]
+);
+
+void quaternion_integrate_rk4_array(
+    const Quaternion q[],
+    const Vector3 rates_start[],
+    const Vector3 rates_end[],
+    const float timestep,
+    const size_t count,
+    Quaternion out[]
+);
+
+// `increments` holds `increment_count` consecutive increments per orientation.
+void quaternion_integrate_coning_array(
+    const Quaternion q[],
+    const Vector3 increments[],
+    const size_t increment_count,
+    const size_t count,
+    Quaternion out[]
+);
+
+#endif
@@ -0,0 +1,164 @@
+#include "quaternion_resampler.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "quaternion.h"
+#include "quaternion_spline.h"
+
+
+#define MAX_KEYS 4
+
+
+static void add_sample(
+    QuaternionResampler* self,
+    const double time,
+    const Quaternion* sample
+) {
+    Quaternion key = quaternion_normalize(sample);
+    
+    if (self->_count == 0) {
+        self->_next_index = (int64_t) ceil(time / self->period);
+    } else {
+        const Quaternion* last = &(self->_keys[self->_count - 1]);
+        if (quaternion_dot(last, &key) < 0) {
+            key = quaternion_negate(&key);
+        }
+    }
+    
+    if (self->_count == MAX_KEYS) {
+        memmove(self->_keys, self->_keys + 1, (MAX_KEYS - 1) * sizeof(Quaternion));
+        memmove(self->_times, self->_times + 1, (MAX_KEYS - 1) * sizeof(double));
+        self->_count--;
+    }
+    
+    self->_keys[self->_count] = key;
+    self->_times[self->_count] = time;
+    self->_count++;
+}
+
+
+// Emits the outputs up to the end of the segment from key `first`. Returns
+// 1 once there are none left, 0 if `out` filled up first.
+static int emit_segment(
+    QuaternionResampler* self,
+    const size_t first,
+    Quaternion out[],
+    double out_times[],
+    const size_t capacity,
+    size_t* written
+) {
+    const double start_time = self->_times[first];
+    const double end_time = self->_times[first + 1];
+    double time = (double) self->_next_index * self->period;
+    if (time > end_time) {
+        return 1;
+    }
+    
+    // The segment is set up once for all of its outputs.
+    struct SlerpState slerp_state;
+    QuaternionSquadSegment segment;
+    if (self->mode == QUATERNION_RESAMPLER_SQUAD) {
+        quaternion_squad_segment_init(
+            &segment, self->_keys, self->_times, self->_count, first
+        );
+    } else {
+        quaternion_slerp_function_init(
+            &(self->_keys[first]), &(self->_keys[first + 1]), &slerp_state
+        );
+    }
+    
+    const double duration = end_time - start_time;
+    while (time <= end_time) {
+        if (*written == capacity) {
+            return 0;
+        }
+        
+        const float u = (float)((time - start_time) / duration);
+        out[*written] = self->mode == QUATERNION_RESAMPLER_SQUAD
+            ? quaternion_squad_segment_evaluate(&segment, u)
+            : quaternion_slerp_function(&slerp_state, u);
+        out_times[*written] = time;
+        (*written)++;
+        
+        self->_next_index++;
+        time = (double) self->_next_index * self->period;
+    }
+    
+    return 1;
+}
+
+
+void quaternion_resampler_init(
+    QuaternionResampler* out_resampler,
+    const double period,
+    const QuaternionResamplerMode mode
+) {
+    out_resampler->period = period;
+    out_resampler->mode = mode;
+    out_resampler->_next_index = 0;
+    out_resampler->_count = 0;
+}
+
+
+size_t quaternion_resampler_push(
+    QuaternionResampler* self,
+    const double times[],
+    const Quaternion samples[],
+    const size_t count,
+    Quaternion out[],
+    double out_times[],
+    const size_t capacity,
+    size_t* out_count
+) {
+    // Segments are complete once the sample after their end has arrived,
+    // or with slerp once their end has.
+    const size_t lag = self->mode == QUATERNION_RESAMPLER_SQUAD ? 3 : 2;
+    *out_count = 0;
+    
+    size_t consumed = 0;
+    for (;;) {
+        if (self->_count >= lag && !emit_segment(
+            self, self->_count - lag, out, out_times, capacity, out_count
+        )) {
+            break;
+        }
+        if (consumed == count) {
+            break;
+        }
+        
+        const int later = self->_count == 0
+            || times[consumed] > self->_times[self->_count - 1];
+        if (later) {
+            add_sample(self, times[consumed], &(samples[consumed]));
+        }
+        consumed++;
+    }
+    
+    return consumed;
+}
+
+
+size_t quaternion_resampler_flush(
+    QuaternionResampler* self,
+    Quaternion out[],
+    double out_times[],
+    const size_t capacity
+) {
+    size_t written = 0;
+    
+    if (self->_count == 1) {
+        // Only an output exactly at the single sample.
+        const double time = (double) self->_next_index * self->period;
+        if (time <= self->_times[0] && capacity > 0) {
+            out[0] = self->_keys[0];
+            out_times[0] = time;
+            self->_next_index++;
+            written = 1;
+        }
+    } else if (self->_count >= 2) {
+        emit_segment(self, self->_count - 2, out, out_times, capacity, &written);
+    }
+    
+    return written;
+}
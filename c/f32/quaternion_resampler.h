@@ -0,0 +1,71 @@
+#ifndef QUATERNION_RESAMPLER_H
+#define QUATERNION_RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+// Resamples a stream of irregularly timed orientations to a fixed rate,
+// consuming it in chunks of any size. Only the last four samples are kept
+// between chunks, never the stream.
+//
+// Outputs are at the multiples of `period`, from the first one at or after
+// the first sample. With slerp an output is emitted as soon as the sample
+// after it arrives. With SQUAD the curve through a segment also depends on
+// the sample after the segment, so outputs lag one more sample, and the
+// last segment is emitted by quaternion_resampler_flush.
+//
+// Never write to struct fields directly.
+// It's ok to read `period` and `mode`.
+
+typedef enum QuaternionResamplerMode {
+    QUATERNION_RESAMPLER_SLERP,
+    QUATERNION_RESAMPLER_SQUAD
+} QuaternionResamplerMode;
+
+typedef struct QuaternionResampler {
+    double period;
+    QuaternionResamplerMode mode;
+    // The next output is at _next_index * period.
+    int64_t _next_index;
+    // The last samples, oldest first, normalized and hemisphere continuous.
+    Quaternion _keys[4];
+    double _times[4];
+    size_t _count;
+} QuaternionResampler;
+
+
+void quaternion_resampler_init(
+    QuaternionResampler* out_resampler,
+    const double period,
+    const QuaternionResamplerMode mode
+);
+
+// Consumes samples in order, writing the outputs that become available to
+// `out` and their times to `out_times`, and the number written to
+// `out_count`. Stops early once `capacity` outputs are written, and returns
+// the number of samples consumed, so the caller can pass the rest again
+// with an emptied buffer. Samples not later than the previous one are
+// dropped.
+size_t quaternion_resampler_push(
+    QuaternionResampler* self,
+    const double times[],
+    const Quaternion samples[],
+    const size_t count,
+    Quaternion out[],
+    double out_times[],
+    const size_t capacity,
+    size_t* out_count
+);
+
+// At the end of the stream, emits the outputs up to the last sample that
+// are still pending. Returns the number written, call again while it fills
+// `out`.
+size_t quaternion_resampler_flush(
+    QuaternionResampler* self,
+    Quaternion out[],
+    double out_times[],
+    const size_t capacity
+);
+
+#endif
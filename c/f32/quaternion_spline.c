@@ -0,0 +1,514 @@
+#include "quaternion_spline.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "quaternion.h"
+#include "vector3.h"
+
+
+#define BATCH_BLOCK_SIZE 64
+
+
+// Segment containing clock time `time`, and the parameter within it.
+static size_t find_segment(
+    const double times[],
+    const size_t count,
+    const double time,
+    float* out_u
+) {
+    if (count < 2 || time <= times[0]) {
+        *out_u = 0.0f;
+        return 0;
+    }
+    if (time >= times[count - 1]) {
+        *out_u = 1.0f;
+        return count - 2;
+    }
+    
+    // times[low] <= time < times[high]
+    size_t low = 0;
+    size_t high = count - 1;
+    while (high - low > 1) {
+        const size_t middle = low + (high - low) / 2;
+        if (times[middle] <= time) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    
+    *out_u = (float)((time - times[low]) / (times[high] - times[low]));
+    return low;
+}
+
+
+// Normalized keys, each flipped into the hemisphere of the previous one.
+// Returns NULL if the allocation failed.
+static Quaternion* continuous_keys(
+    const Quaternion keys[],
+    const size_t count
+) {
+    Quaternion* continuous = (Quaternion*) malloc(count * sizeof(Quaternion));
+    if (!continuous) {
+        return NULL;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        continuous[i] = quaternion_normalize(&(keys[i]));
+        if (i > 0 && quaternion_dot(&(continuous[i - 1]), &(continuous[i])) < 0) {
+            continuous[i] = quaternion_negate(&(continuous[i]));
+        }
+    }
+    
+    return continuous;
+}
+
+
+// Copies the times and allocates one segment per pair of keys, or one for
+// a single key. Returns NULL if the allocation failed.
+static void* init_times_and_segments(
+    double** out_times,
+    const double times[],
+    const size_t count,
+    const size_t segment_size
+) {
+    const size_t segment_count = count > 1 ? count - 1 : 1;
+    *out_times = (double*) malloc(count * sizeof(double));
+    void* segments = malloc(segment_count * segment_size);
+    
+    if (!*out_times || !segments) {
+        free(*out_times);
+        free(segments);
+        *out_times = NULL;
+        return NULL;
+    }
+    
+    memcpy(*out_times, times, count * sizeof(double));
+    return segments;
+}
+
+
+// Vector part of the logarithm of the rotation from q0 to q1.
+static inline Vector3 log_vector(
+    const Quaternion* q0,
+    const Quaternion* q1
+) {
+    const Quaternion log = quaternion_log_map(q0, q1);
+    return vector3_new(log.x, log.y, log.z);
+}
+
+
+// q0 exp(scale * tangent)
+static inline Quaternion exp_step(
+    const Quaternion* q0,
+    const Vector3* tangent,
+    const float scale
+) {
+    const Quaternion step = quaternion_new(
+        tangent->x * scale, tangent->y * scale, tangent->z * scale, 0.0f
+    );
+    return quaternion_exp_map(q0, &step);
+}
+
+
+// Cumulative basis functions of the uniform cubic B-spline.
+static inline void bspline_basis(
+    const float u,
+    float out_basis[3]
+) {
+    const float uu = u * u;
+    const float uuu = uu * u;
+    out_basis[0] = (5.0f + 3.0f * u - 3.0f * uu + uuu) * (1.0f / 6.0f);
+    out_basis[1] = (1.0f + 3.0f * u + 3.0f * uu - 2.0f * uuu) * (1.0f / 6.0f);
+    out_basis[2] = uuu * (1.0f / 6.0f);
+}
+
+
+// Velocity at key i in log units per second: the time weighted second
+// order difference through its neighbours, one sided at the end keys.
+// Also gives the logarithms of the rotations to the next and previous
+// keys, or to the nearest key at the ends. `count` must be at least 3.
+static Vector3 key_velocity(
+    const Quaternion q[],
+    const double times[],
+    const size_t count,
+    const size_t i,
+    Vector3* out_to_next,
+    Vector3* out_to_previous
+) {
+    if (i == 0 || i == count - 1) {
+        const int first = i == 0;
+        const size_t near = first ? 1 : count - 2;
+        const size_t far = first ? 2 : count - 3;
+        const double near_time = fabs(times[near] - times[i]);
+        const double far_time = fabs(times[far] - times[near]);
+        const float near_weight = (float)(
+            (near_time + far_time) / (near_time * far_time)
+        );
+        const float far_weight = (float)(
+            -near_time / (far_time * (near_time + far_time))
+        );
+        
+        const Vector3 to_near = log_vector(&(q[i]), &(q[near]));
+        const Vector3 to_far = log_vector(&(q[i]), &(q[far]));
+        const Vector3 near_term = vector3_scale(&to_near, near_weight);
+        const Vector3 far_term = vector3_scale(&to_far, far_weight);
+        const Vector3 velocity = vector3_add(&near_term, &far_term);
+        *out_to_next = to_near;
+        *out_to_previous = to_near;
+        return vector3_scale(&velocity, first ? 1.0f : -1.0f);
+    }
+    
+    const double previous_time = times[i] - times[i - 1];
+    const double next_time = times[i + 1] - times[i];
+    const double total_time = previous_time + next_time;
+    
+    *out_to_next = log_vector(&(q[i]), &(q[i + 1]));
+    *out_to_previous = log_vector(&(q[i]), &(q[i - 1]));
+    const Vector3 next_term = vector3_scale(
+        out_to_next, (float)(previous_time / (next_time * total_time))
+    );
+    const Vector3 previous_term = vector3_scale(
+        out_to_previous, (float)(-next_time / (previous_time * total_time))
+    );
+    return vector3_add(&next_term, &previous_term);
+}
+
+
+// Segment from key i to key i + 1 of the SQUAD through `count` continuous
+// keys. The inner points on either side of a key differ when the segments
+// have different durations.
+static void squad_segment(
+    const Quaternion q[],
+    const double times[],
+    const size_t count,
+    const size_t i,
+    QuaternionSquadSegment* out_segment
+) {
+    Quaternion inner = q[i];
+    Quaternion next_inner = q[i + 1];
+    
+    // The outer slerp leaves a key with the tangent to the next key plus
+    // twice the tangent to the inner point, per segment.
+    if (count >= 3) {
+        const float duration = (float)(times[i + 1] - times[i]);
+        Vector3 to_next;
+        Vector3 to_previous;
+        
+        Vector3 velocity = key_velocity(q, times, count, i, &to_next, &to_previous);
+        Vector3 tangent = vector3_scale(&velocity, duration);
+        Vector3 step = vector3_sub(&tangent, &to_next);
+        inner = exp_step(&(q[i]), &step, 0.5f);
+        
+        velocity = key_velocity(q, times, count, i + 1, &to_next, &to_previous);
+        tangent = vector3_scale(&velocity, duration);
+        step = vector3_add(&tangent, &to_previous);
+        next_inner = exp_step(&(q[i + 1]), &step, -0.5f);
+    }
+    
+    out_segment->key = q[i];
+    out_segment->inner = inner;
+    out_segment->key_tangent = log_vector(&(q[i]), &(q[i + 1]));
+    out_segment->inner_tangent = log_vector(&inner, &next_inner);
+}
+
+
+int quaternion_squad_init(
+    QuaternionSquad* out_curve,
+    const Quaternion keys[],
+    const double times[],
+    const size_t count
+) {
+    out_curve->times = NULL;
+    out_curve->count = 0;
+    out_curve->_segments = NULL;
+    
+    if (count == 0) {
+        return 0;
+    }
+    
+    Quaternion* q = continuous_keys(keys, count);
+    QuaternionSquadSegment* segments = init_times_and_segments(
+        &(out_curve->times), times, count, sizeof(QuaternionSquadSegment)
+    );
+    
+    if (!q || !segments) {
+        free(q);
+        free(segments);
+        free(out_curve->times);
+        out_curve->times = NULL;
+        return 0;
+    }
+    
+    if (count == 1) {
+        segments[0].key = q[0];
+        segments[0].inner = q[0];
+        segments[0].key_tangent = vector3_new(0.0f, 0.0f, 0.0f);
+        segments[0].inner_tangent = vector3_new(0.0f, 0.0f, 0.0f);
+    }
+    for (size_t i = 0; i + 1 < count; i++) {
+        squad_segment(q, times, count, i, &(segments[i]));
+    }
+    
+    free(q);
+    
+    out_curve->count = count;
+    out_curve->_segments = segments;
+    return 1;
+}
+
+
+void quaternion_squad_free(
+    QuaternionSquad* self
+) {
+    free(self->times);
+    free(self->_segments);
+    self->times = NULL;
+    self->_segments = NULL;
+    self->count = 0;
+}
+
+
+void quaternion_squad_segment_init(
+    QuaternionSquadSegment* out_segment,
+    const Quaternion keys[],
+    const double times[],
+    const size_t count,
+    const size_t first
+) {
+    // Only the two keys on either side of the segment affect it.
+    const size_t start = first > 0 ? first - 1 : 0;
+    const size_t end = first + 3 < count ? first + 3 : count;
+    
+    Quaternion q[4];
+    for (size_t i = start; i < end; i++) {
+        q[i - start] = quaternion_normalize(&(keys[i]));
+        if (i > start && quaternion_dot(&(q[i - start - 1]), &(q[i - start])) < 0) {
+            q[i - start] = quaternion_negate(&(q[i - start]));
+        }
+    }
+    
+    squad_segment(q, &(times[start]), end - start, first - start, out_segment);
+}
+
+
+Quaternion quaternion_squad_segment_evaluate(
+    const QuaternionSquadSegment* self,
+    const float u
+) {
+    const Quaternion on_keys = exp_step(&(self->key), &(self->key_tangent), u);
+    const Quaternion on_inner = exp_step(&(self->inner), &(self->inner_tangent), u);
+    
+    const Quaternion log = quaternion_log_map(&on_keys, &on_inner);
+    const Vector3 between = vector3_new(log.x, log.y, log.z);
+    const Quaternion out = exp_step(&on_keys, &between, 2.0f * u * (1.0f - u));
+    return quaternion_normalize(&out);
+}
+
+
+Quaternion quaternion_squad_evaluate(
+    const QuaternionSquad* self,
+    const double time
+) {
+    float u;
+    const QuaternionSquadSegment* segment = &(self->_segments[
+        find_segment(self->times, self->count, time, &u)
+    ]);
+    return quaternion_squad_segment_evaluate(segment, u);
+}
+
+
+// Three batched exponential maps: the two inner slerps together, then the
+// outer one after the logarithms of the rotations between their results.
+void quaternion_squad_evaluate_batch(
+    const QuaternionSquad curves[],
+    const size_t count,
+    const double time,
+    Quaternion out[]
+) {
+    const QuaternionSquadSegment* segments[BATCH_BLOCK_SIZE];
+    float weights[BATCH_BLOCK_SIZE];
+    Quaternion steps[2 * BATCH_BLOCK_SIZE];
+    Quaternion on_keys[BATCH_BLOCK_SIZE];
+    Quaternion between[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            const QuaternionSquad* curve = &(curves[start + i]);
+            float u;
+            const QuaternionSquadSegment* segment = &(curve->_segments[
+                find_segment(curve->times, curve->count, time, &u)
+            ]);
+            segments[i] = segment;
+            weights[i] = 2.0f * u * (1.0f - u);
+            steps[i] = quaternion_from_vector(&(segment->key_tangent), 0.0f);
+            steps[i] = quaternion_scale(&(steps[i]), u);
+            steps[block + i] = quaternion_from_vector(&(segment->inner_tangent), 0.0f);
+            steps[block + i] = quaternion_scale(&(steps[block + i]), u);
+        }
+        
+        quaternion_exp_batch(steps, 2 * block, steps);
+        
+        for (size_t i = 0; i < block; i++) {
+            on_keys[i] = quaternion_mul(&(segments[i]->key), &(steps[i]));
+            const Quaternion on_inner = quaternion_mul(
+                &(segments[i]->inner), &(steps[block + i])
+            );
+            const Quaternion inverse = quaternion_conjugate(&(on_keys[i]));
+            between[i] = quaternion_mul(&inverse, &on_inner);
+        }
+        
+        quaternion_log_batch(between, block, between);
+        for (size_t i = 0; i < block; i++) {
+            between[i] = quaternion_new(
+                between[i].x * weights[i],
+                between[i].y * weights[i],
+                between[i].z * weights[i],
+                0.0f
+            );
+        }
+        quaternion_exp_batch(between, block, between);
+        
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion result = quaternion_mul(&(on_keys[i]), &(between[i]));
+            out[start + i] = quaternion_normalize(&result);
+        }
+    }
+}
+
+
+int quaternion_bspline_init(
+    QuaternionBSpline* out_curve,
+    const Quaternion keys[],
+    const double times[],
+    const size_t count
+) {
+    out_curve->times = NULL;
+    out_curve->count = 0;
+    out_curve->_segments = NULL;
+    
+    if (count == 0) {
+        return 0;
+    }
+    
+    Quaternion* q = continuous_keys(keys, count);
+    QuaternionBSplineSegment* segments = init_times_and_segments(
+        &(out_curve->times), times, count, sizeof(QuaternionBSplineSegment)
+    );
+    
+    if (!q || !segments) {
+        free(q);
+        free(segments);
+        free(out_curve->times);
+        out_curve->times = NULL;
+        return 0;
+    }
+    
+    // Control point k is q[k] clamped to the keys, so the tangents into
+    // the repeated end keys are zero.
+    const long last = (long)count - 1;
+    const size_t segment_count = count > 1 ? count - 1 : 1;
+    for (size_t i = 0; i < segment_count; i++) {
+        const long base = (long)i - 1;
+        segments[i].base = q[base < 0 ? 0 : base];
+        
+        for (long j = 0; j < 3; j++) {
+            const long from = base + j;
+            const long to = from + 1;
+            segments[i].tangents[j] = log_vector(
+                &(q[from < 0 ? 0 : from > last ? last : from]),
+                &(q[to < 0 ? 0 : to > last ? last : to])
+            );
+        }
+    }
+    
+    free(q);
+    
+    out_curve->count = count;
+    out_curve->_segments = segments;
+    return 1;
+}
+
+
+void quaternion_bspline_free(
+    QuaternionBSpline* self
+) {
+    free(self->times);
+    free(self->_segments);
+    self->times = NULL;
+    self->_segments = NULL;
+    self->count = 0;
+}
+
+
+Quaternion quaternion_bspline_evaluate(
+    const QuaternionBSpline* self,
+    const double time
+) {
+    float u;
+    const QuaternionBSplineSegment* segment = &(self->_segments[
+        find_segment(self->times, self->count, time, &u)
+    ]);
+    
+    float basis[3];
+    bspline_basis(u, basis);
+    
+    Quaternion out = segment->base;
+    for (int j = 0; j < 3; j++) {
+        out = exp_step(&out, &(segment->tangents[j]), basis[j]);
+    }
+    return quaternion_normalize(&out);
+}
+
+
+void quaternion_bspline_evaluate_batch(
+    const QuaternionBSpline curves[],
+    const size_t count,
+    const double time,
+    Quaternion out[]
+) {
+    const QuaternionBSplineSegment* segments[BATCH_BLOCK_SIZE];
+    Quaternion steps[3 * BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            const QuaternionBSpline* curve = &(curves[start + i]);
+            float u;
+            const QuaternionBSplineSegment* segment = &(curve->_segments[
+                find_segment(curve->times, curve->count, time, &u)
+            ]);
+            segments[i] = segment;
+            
+            float basis[3];
+            bspline_basis(u, basis);
+            for (size_t j = 0; j < 3; j++) {
+                const Quaternion tangent = quaternion_from_vector(
+                    &(segment->tangents[j]), 0.0f
+                );
+                steps[3 * i + j] = quaternion_scale(&tangent, basis[j]);
+            }
+        }
+        
+        quaternion_exp_batch(steps, 3 * block, steps);
+        
+        for (size_t i = 0; i < block; i++) {
+            Quaternion result = segments[i]->base;
+            for (size_t j = 0; j < 3; j++) {
+                result = quaternion_mul(&result, &(steps[3 * i + j]));
+            }
+            out[start + i] = quaternion_normalize(&result);
+        }
+    }
+}
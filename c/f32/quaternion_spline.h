@@ -0,0 +1,131 @@
+#ifndef QUATERNION_SPLINE_H
+#define QUATERNION_SPLINE_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Smooth rotation curves through timed keys, so far fewer keys are needed
+// than with slerp between them. The per segment control points are
+// computed once at init, and evaluation is a fixed number of exponential
+// maps: a cubic curve segment costs three.
+//
+// Within a segment the curve parameter is linear in time. Keys are
+// normalized and flipped into the hemisphere of the previous key. Times
+// before the first key or after the last are clamped to the ends.
+//
+// Never write to struct fields directly.
+// It's ok to read `times` and `count`.
+
+// SQUAD, spherical cubic interpolation: passes through every key with a
+// continuous angular velocity. Segment i is
+//
+//   slerp(slerp(q_i, q_i+1, u), slerp(s_i, s_i+1, u), 2u(1 - u))
+//
+// For evenly spaced keys the inner control point is s_i = q_i
+// exp(-(log(q_i^-1 q_i+1) + log(q_i^-1 q_i-1)) / 4). In general the
+// velocity at each key is the time weighted difference through its
+// neighbours, one sided at the end keys, and the inner points on either
+// side of a key are placed to match it over each segment's duration.
+typedef struct QuaternionSquadSegment {
+    Quaternion key;
+    Quaternion inner;
+    // Logarithms of the rotations to the next key and inner point, so
+    // that slerp(key, next, u) = key exp(u key_tangent).
+    Vector3 key_tangent;
+    Vector3 inner_tangent;
+} QuaternionSquadSegment;
+
+typedef struct QuaternionSquad {
+    double* times;
+    size_t count;
+    QuaternionSquadSegment* _segments;
+} QuaternionSquad;
+
+// Cumulative cubic B-spline (Kim, Kim and Shin 1995): the keys are control
+// points the curve passes near, and the angular acceleration is
+// continuous. Segment i is
+//
+//   q_i-1 exp(B1(u) w_i) exp(B2(u) w_i+1) exp(B3(u) w_i+2)
+//
+// with w_k = log(q_k-1^-1 q_k), and the end keys repeated.
+typedef struct QuaternionBSplineSegment {
+    Quaternion base;
+    Vector3 tangents[3];
+} QuaternionBSplineSegment;
+
+typedef struct QuaternionBSpline {
+    double* times;
+    size_t count;
+    QuaternionBSplineSegment* _segments;
+} QuaternionBSpline;
+
+
+// `times` must be increasing. Returns 0 if `count` is 0 or the allocation
+// failed.
+int quaternion_squad_init(
+    QuaternionSquad* out_curve,
+    const Quaternion keys[],
+    const double times[],
+    const size_t count
+);
+
+void quaternion_squad_free(
+    QuaternionSquad* self
+);
+
+Quaternion quaternion_squad_evaluate(
+    const QuaternionSquad* self,
+    const double time
+);
+
+// Evaluates `count` curves at the same time, with the exponential maps of
+// all curves batched through the simd_math functions.
+void quaternion_squad_evaluate_batch(
+    const QuaternionSquad curves[],
+    const size_t count,
+    const double time,
+    Quaternion out[]
+);
+
+// Segment `first` of the SQUAD through `count` keys, computed from the at
+// most four keys around it, so that a stream can build its segments as
+// keys arrive. `count` must be at least 2.
+void quaternion_squad_segment_init(
+    QuaternionSquadSegment* out_segment,
+    const Quaternion keys[],
+    const double times[],
+    const size_t count,
+    const size_t first
+);
+
+// u is the parameter along the segment, from 0 at its key to 1 at the next.
+Quaternion quaternion_squad_segment_evaluate(
+    const QuaternionSquadSegment* self,
+    const float u
+);
+
+
+int quaternion_bspline_init(
+    QuaternionBSpline* out_curve,
+    const Quaternion keys[],
+    const double times[],
+    const size_t count
+);
+
+void quaternion_bspline_free(
+    QuaternionBSpline* self
+);
+
+Quaternion quaternion_bspline_evaluate(
+    const QuaternionBSpline* self,
+    const double time
+);
+
+void quaternion_bspline_evaluate_batch(
+    const QuaternionBSpline curves[],
+    const size_t count,
+    const double time,
+    Quaternion out[]
+);
+
+#endif
@@ -3,10 +3,135 @@
 #include <math.h>
 
 #include "quaternion.h"
+#include "quaternion_integrator.h"
+#include "simd_math.h"
+#include "spring.h"
 #include "vector3.h"
 
 
-// concern: floats may not provide enough accuracy for expf
+#define SAMPLE_BLOCK_SIZE 64
+
+
+// The position and velocity updates both depend on the rotation from the
+// position to the target. Computing its log map once replaces the separate
+// slerp, quaternion_difference and quaternion_to_euler_vector of the
+// unfused update (3 normalizations, an inverse, 2 acosf and 3 sinf) with a
+// single product, normalization and atan2f, and the slerp becomes an
+// exponential map step like the velocity integration.
+
+// Rotation vector (axis * angle) taking `position` to `target` along the
+// shortest path, the log map of conjugate(position) * target.
+static inline Vector3 relative_rotation(
+    const Quaternion* position,
+    const Quaternion* target
+) {
+    const Quaternion p = *position;
+    const Quaternion t = *target;
+    
+    float x = p.w * t.x - p.x * t.w - (p.y * t.z - p.z * t.y);
+    float y = p.w * t.y - p.y * t.w - (p.z * t.x - p.x * t.z);
+    float z = p.w * t.z - p.z * t.w - (p.x * t.y - p.y * t.x);
+    float w = p.w * t.w + p.x * t.x + p.y * t.y + p.z * t.z;
+    
+    const float sign = w < 0 ? -1.0f : 1.0f;
+    w *= sign;
+    
+    // atan2f keeps full relative precision as the angle goes to zero, so
+    // no small angle case is needed, and scaling by the vector length
+    // makes non-unit inputs harmless.
+    const float s = sqrtf(x * x + y * y + z * z);
+    const float scale = s > 0 ? sign * 2.0f * atan2f(s, w) / s : 0.0f;
+    
+    return vector3_new(
+        spring_flush(x * scale), spring_flush(y * scale), spring_flush(z * scale)
+    );
+}
+
+
+// slerp(position, target, pull_to_target) followed by integrating the
+// velocity over vel_pos_push, as two exponential map steps.
+static inline Quaternion spring_position(
+    const Quaternion* position,
+    const Vector3* rotation,
+    const Vector3* velocity,
+    const float pull_to_target,
+    const float vel_pos_push
+) {
+    const Quaternion pulled = quaternion_integrate_exp(
+        position, rotation, pull_to_target
+    );
+    const Quaternion pushed = quaternion_integrate_exp(
+        &pulled, velocity, vel_pos_push
+    );
+    
+    return quaternion_normalize(&pushed);
+}
+
+
+// spring_position for a block of samples. The rotation and velocity are
+// shared, so only the step angles vary, and the sines and cosines of both
+// steps of every sample are computed together.
+static void spring_positions(
+    const Quaternion* position,
+    const Vector3* rotation,
+    const Vector3* velocity,
+    const float pull_to_target[],
+    const float vel_pos_push[],
+    const size_t count,
+    Quaternion out_positions[]
+) {
+    float half_angles[2 * SAMPLE_BLOCK_SIZE];
+    float sines[2 * SAMPLE_BLOCK_SIZE];
+    float cosines[2 * SAMPLE_BLOCK_SIZE];
+    
+    const float rotation_angle = vector3_magnitude(rotation);
+    const float velocity_angle = vector3_magnitude(velocity);
+    for (size_t i = 0; i < count; i++) {
+        half_angles[i] = 0.5f * rotation_angle * pull_to_target[i];
+        half_angles[count + i] = 0.5f * velocity_angle * vel_pos_push[i];
+    }
+    simd_sincos(half_angles, 2 * count, sines, cosines, SIMD_MATH_PRECISE);
+    
+    const Vector3 rotation_axis = vector3_scale(
+        rotation, rotation_angle > 0 ? 1 / rotation_angle : 0
+    );
+    const Vector3 velocity_axis = vector3_scale(
+        velocity, velocity_angle > 0 ? 1 / velocity_angle : 0
+    );
+    
+    for (size_t i = 0; i < count; i++) {
+        const float pull_sin = sines[i];
+        const float push_sin = sines[count + i];
+        const Quaternion pull = quaternion_new(
+            rotation_axis.x * pull_sin, rotation_axis.y * pull_sin,
+            rotation_axis.z * pull_sin, cosines[i]
+        );
+        const Quaternion push = quaternion_new(
+            velocity_axis.x * push_sin, velocity_axis.y * push_sin,
+            velocity_axis.z * push_sin, cosines[count + i]
+        );
+        
+        const Quaternion pulled = quaternion_mul(position, &pull);
+        const Quaternion pushed = quaternion_mul(&pulled, &push);
+        out_positions[i] = quaternion_normalize(&pushed);
+    }
+}
+
+
+static inline Vector3 spring_velocity(
+    const Vector3* rotation,
+    const Vector3* velocity,
+    const float vel_push_rate,
+    const float velocity_decay
+) {
+    return vector3_new(
+        spring_flush(rotation->x * vel_push_rate + velocity->x * velocity_decay),
+        spring_flush(rotation->y * vel_push_rate + velocity->y * velocity_decay),
+        spring_flush(rotation->z * vel_push_rate + velocity->z * velocity_decay)
+    );
+}
+
+
 void evaluate_spring(
     const QuaternionSpring* self, 
     const double now, 
@@ -16,89 +141,149 @@ void evaluate_spring(
     const Quaternion current_position = self->position;
     const Quaternion current_target = self->target;
     const Vector3 current_velocity = self->velocity;
-    const float damping = self->damping;
-    const float speed = self->speed;
     
-    const float dt = speed * (float)(now - self->_time);
-    const float damping_squared = damping * damping;
+    const float dt = self->speed * (float)(now - self->_time);
+    float pull_to_target, vel_pos_push, vel_push_rate, velocity_decay;
+    spring_coefficients(
+        self->damping, self->speed, &dt, 1,
+        &pull_to_target, &vel_pos_push, &vel_push_rate, &velocity_decay
+    );
     
-    float ang_freq, sin_theta, cos_theta;
-    if (damping_squared < 1) {
-        ang_freq = sqrtf(1 - damping_squared);
-        const float exponential = expf(-damping * dt) / ang_freq;
-        const float afdt = ang_freq * dt;
-        #ifdef _GNU_SOURCE
-            float sin_tm, cos_tm;
-            sincosf(afdt, &sin_tm, &cos_tm);
-            sin_theta = exponential * sin_tm;
-            cos_theta = exponential * cos_tm;
-        #else
-            sin_theta = exponential * sinf(afdt);
-            cos_theta = exponential * cosf(afdt);
-        #endif
-    } else if (damping_squared == 1) {
-        ang_freq = 1;
-        const float exponential = expf(-damping * dt);
-        sin_theta = exponential * dt;
-        cos_theta = exponential;
-    } else {
-        ang_freq = sqrtf(damping_squared - 1);
-        const float ang_freq_2 = 1 / (2 * ang_freq);
-        const float m_damping = -damping;
-        const float u = expf((m_damping + ang_freq) * dt) * ang_freq_2;
-        const float v = expf((m_damping - ang_freq) * dt) * ang_freq_2;
-        sin_theta = u - v;
-        cos_theta = u + v;
-    }
+    const Vector3 rotation = relative_rotation(&current_position, &current_target);
     
     if (out_position) {
-        const float pull_to_target = 1 - (
-            ang_freq * cos_theta + damping * sin_theta
-        );
-        const float vel_pos_push = sin_theta / speed;
-        
-        const Quaternion pos_quat = quaternion_slerp(
-            &current_position, &current_target, pull_to_target
-        );
-        *out_position = quaternion_integrate(
-            &pos_quat, &current_velocity, vel_pos_push
+        *out_position = spring_position(
+            &current_position, &rotation, &current_velocity,
+            pull_to_target, vel_pos_push
         );
     }
     
     if (out_velocity) {
-        const float vel_push_rate = speed * sin_theta;
-        const float velocity_decay = ang_freq * cos_theta - damping * sin_theta;
-        const Quaternion dif_quat = quaternion_difference(
-            &current_position, &current_target
+        *out_velocity = spring_velocity(
+            &rotation, &current_velocity, vel_push_rate, velocity_decay
         );
-        const Vector3 euler_vec = quaternion_to_euler_vector(&dif_quat);
-        const Vector3 vel_push = vector3_scale(&euler_vec, vel_push_rate);
-        const Vector3 vel_decay = vector3_scale(&current_velocity, velocity_decay);
+    }
+}
+
+static inline double time_now(const QuaternionSpring* self) {
+    return quaternion_spring_now(self);
+}
+
+
+// Moves the spring at `index` to `other_index` and vice versa.
+static inline void group_swap(
+    QuaternionSpringGroup* group,
+    const size_t index,
+    const size_t other_index
+) {
+    QuaternionSpring* spring = group->springs[index];
+    QuaternionSpring* other = group->springs[other_index];
+    group->springs[index] = other;
+    group->springs[other_index] = spring;
+    other->_group_index = index;
+    spring->_group_index = other_index;
+}
+
+
+static int is_settled(
+    const QuaternionSpring* self
+) {
+    const float epsilon = self->settle_epsilon;
+    const Vector3 velocity = self->velocity;
+    const float speed_squared = velocity.x * velocity.x
+        + velocity.y * velocity.y + velocity.z * velocity.z;
     
-        *out_velocity = vector3_add(&vel_push, &vel_decay);
+    return speed_squared < epsilon * epsilon && fabsf(
+        quaternion_dot(&(self->position), &(self->target))
+    ) > self->_settle_cos;
+}
+
+
+// Snaps to the target and leaves the group's active set.
+void quaternion_spring_sleep(
+    QuaternionSpring* self
+) {
+    if (self->sleeping) {
+        return;
+    }
+    
+    self->position = self->target;
+    self->velocity = VECTOR3_ZERO;
+    self->sleeping = 1;
+    
+    QuaternionSpringGroup* group = self->_group;
+    if (group) {
+        group_swap(group, self->_group_index, group->active_count - 1);
+        group->active_count--;
     }
 }
 
-inline double time_now(const QuaternionSpring* self) {
-    return self->clock(self->clock_state);
+
+// A resting spring is the same at every time, so it restarts from `now`.
+static void wake_spring(
+    QuaternionSpring* self,
+    const double now
+) {
+    if (!self->sleeping) {
+        return;
+    }
+    
+    self->sleeping = 0;
+    self->_time = now;
+    
+    QuaternionSpringGroup* group = self->_group;
+    if (group) {
+        group_swap(group, self->_group_index, group->active_count);
+        group->active_count++;
+    }
 }
 
 
+// The stored position and velocity are always the state at `_time`, which
+// makes `_time` the memoization key: once advanced to `now`, further reads
+// and setters in the same tick skip evaluate_spring. Fields passed as NULL
+// are not needed by the caller and are left stale.
+// Returns 1 if the spring was evaluated.
+static int advance_spring(
+    QuaternionSpring* self,
+    const double now,
+    Quaternion* position,
+    Vector3* velocity
+) {
+    const int evaluated = now != self->_time && !self->sleeping;
+    if (evaluated) {
+        evaluate_spring(self, now, position, velocity);
+    }
+    self->_time = now;
+    return evaluated;
+}
+
+
+// Advances the stored position and velocity to the current time, so the
+// fields can be read afterwards. Either output may be NULL.
 void quaternion_spring_evaluate(
     QuaternionSpring* self,
     Quaternion* out_position,
     Vector3* out_velocity
 ) {
     double now = time_now(self);
-    evaluate_spring(self, now, out_position, out_velocity);
-    self->_time = now;
+    if (advance_spring(self, now, &(self->position), &(self->velocity))
+        && is_settled(self)) {
+        quaternion_spring_sleep(self);
+    }
+    
+    if (out_position) {
+        *out_position = self->position;
+    }
+    if (out_velocity) {
+        *out_velocity = self->velocity;
+    }
 }
 
 void quaternion_spring_evaluate_npv(
     QuaternionSpring* self
 ) {
-    double now = time_now(self);
-    self->_time = now;
+    quaternion_spring_evaluate(self, NULL, NULL);
 }
 
 
@@ -107,9 +292,9 @@ void quaternion_spring_set_position(
     const Quaternion* position
 ) {
     double now = time_now(self);
-    evaluate_spring(self, now, NULL, &(self->velocity));
+    advance_spring(self, now, NULL, &(self->velocity));
+    wake_spring(self, now);
     self->position = *position;
-    self->_time = now;
 }
 
 
@@ -118,9 +303,9 @@ void quaternion_spring_set_target(
     const Quaternion* target
 ) {
     double now = time_now(self);
-    evaluate_spring(self, now, &(self->position), &(self->velocity));
+    advance_spring(self, now, &(self->position), &(self->velocity));
+    wake_spring(self, now);
     self->target = *target;
-    self->_time = now;
 }
 
 
@@ -129,9 +314,9 @@ void quaternion_spring_set_velocity(
     const Vector3* velocity
 ) {
     double now = time_now(self);
-    evaluate_spring(self, now, &(self->position), NULL);
+    advance_spring(self, now, &(self->position), NULL);
+    wake_spring(self, now);
     self->velocity = *velocity;
-    self->_time = now;
 }
 
 
@@ -139,10 +324,8 @@ void quaternion_spring_set_damping(
     QuaternionSpring* self,
     const float damping
 ) {
-    double now = time_now(self);
-    evaluate_spring(self, now, &(self->position), &(self->velocity));
+    advance_spring(self, time_now(self), &(self->position), &(self->velocity));
     self->damping = damping;
-    self->_time = now;
 }
 
 
@@ -150,23 +333,30 @@ void quaternion_spring_set_speed(
     QuaternionSpring* self,
     const float speed
 ) {
-    double now = time_now(self);
-    evaluate_spring(self, now, &(self->position), &(self->velocity));
+    advance_spring(self, time_now(self), &(self->position), &(self->velocity));
     self->speed = speed;
-    self->_time = now;
 }
 
 void quaternion_spring_set_clock(
     QuaternionSpring* self,
-    const double (*clock)(void*),
-    const void* clock_state
+    double (*clock)(void*),
+    void* clock_state
 ) {
-    double now = time_now(self);
-    evaluate_spring(self, now, &(self->position), &(self->velocity));
+    advance_spring(self, time_now(self), &(self->position), &(self->velocity));
     self->clock = clock;
+    self->clock_state = clock_state;
+    self->frame_clock = NULL;
     self->_time = clock(clock_state);
 }
 
+void quaternion_spring_set_frame_clock(
+    QuaternionSpring* self,
+    const FrameClock* frame_clock
+) {
+    quaternion_spring_set_clock(self, frame_clock_read, (void*)frame_clock);
+    self->frame_clock = frame_clock;
+}
+
 
 void quaternion_spring_reset(
     QuaternionSpring* self,
@@ -184,10 +374,117 @@ void quaternion_spring_impulse(
     QuaternionSpring* self,
     const Vector3* impulse
 ) {
+    double now = time_now(self);
+    advance_spring(self, now, &(self->position), &(self->velocity));
+    wake_spring(self, now);
     self->velocity = vector3_add(&(self->velocity), impulse);
 }
 
 
+// Smallest t >= 0 after which (a + b * t) * e^-t stays below `epsilon`.
+// h(t) = ln(a + b * t) - t - ln(epsilon) is concave, so Newton's method
+// started right of the last root converges monotonically from the right.
+static float critical_settle_time(
+    const float a,
+    const float b,
+    const float epsilon
+) {
+    const float log_epsilon = logf(epsilon);
+    
+    float t = b > a ? 1 - a / b : 0;
+    if (logf(a + b * t) - t <= log_epsilon) {
+        return 0;
+    }
+    
+    t += 1 + 2 * logf((a + b) / epsilon);
+    while (logf(a + b * t) - t > log_epsilon) {
+        t *= 2;
+    }
+    
+    for (int i = 0; i < 8; i++) {
+        const float h = logf(a + b * t) - t - log_epsilon;
+        const float dh = b / (a + b * t) - 1;
+        t -= h / dh;
+    }
+    
+    return t;
+}
+
+
+// The rotation from position to target decays like a scalar spring, so
+// the displacement and velocity are bounded by x0 * f(t) + v0 * g(t) for
+// the scalar responses f and g of each damping regime. The time returned
+// is where both bounds drop below epsilon, so it is conservative.
+double quaternion_spring_settle_time(
+    const QuaternionSpring* self,
+    const float epsilon
+) {
+    // The regimes would disagree on a zero epsilon, and a negative one
+    // would read as settled at once.
+    if (!(epsilon > 0)) {
+        return HUGE_VAL;
+    }
+    
+    if (self->sleeping) {
+        return self->_time;
+    }
+    
+    const Quaternion dif_quat = quaternion_difference(
+        &(self->position), &(self->target)
+    );
+    const Vector3 euler_vec = quaternion_to_euler_vector(&dif_quat);
+    const float x0 = vector3_magnitude(&euler_vec);
+    const float speed = self->speed;
+    const float damping = self->damping;
+    const float real_v0 = vector3_magnitude(&(self->velocity));
+    
+    if (x0 < epsilon && real_v0 < epsilon) {
+        return self->_time;
+    }
+    
+    if (!(speed > 0) || !(damping > 0)) {
+        return HUGE_VAL;
+    }
+    
+    // In speed scaled time the velocity bound is epsilon / speed.
+    const float v0 = real_v0 / speed;
+    const float vel_epsilon = epsilon / speed;
+    const float damping_squared = damping * damping;
+    
+    float scaled_time;
+    if (damping_squared < 1) {
+        const float ang_freq = sqrtf(1 - damping_squared);
+        const float amplitude = (x0 + v0) / ang_freq;
+        scaled_time = logf(amplitude / fminf(epsilon, vel_epsilon)) / damping;
+    } else if (damping_squared == 1) {
+        scaled_time = fmaxf(
+            critical_settle_time(x0, x0 + v0, epsilon),
+            critical_settle_time(v0, x0 + v0, vel_epsilon)
+        );
+    } else {
+        const float ang_freq = sqrtf(damping_squared - 1);
+        const float inv_2_ang_freq = 1 / (2 * ang_freq);
+        const float pos_amplitude = (x0 * (damping + ang_freq) + v0) * inv_2_ang_freq;
+        const float vel_amplitude = (x0 + 2 * damping * v0) * inv_2_ang_freq;
+        scaled_time = fmaxf(
+            logf(pos_amplitude / epsilon),
+            logf(vel_amplitude / vel_epsilon)
+        ) / (damping - ang_freq);
+    }
+    
+    return self->_time + fmaxf(scaled_time, 0) / speed;
+}
+
+
+void quaternion_spring_set_settle_epsilon(
+    QuaternionSpring* self,
+    const float epsilon
+) {
+    self->settle_epsilon = epsilon;
+    self->_settle_cos = epsilon > 0 ? cosf(0.5f * epsilon) : 2.0f;
+}
+
+
 void quaternion_spring_time_skip(
     QuaternionSpring* self,
     const double delta
@@ -197,3 +494,131 @@ void quaternion_spring_time_skip(
     self->_time = now;
 }
 
+
+
+// The rotation from position to target only depends on the state, so it is
+// computed once and shared by every sample.
+void quaternion_spring_sample(
+    const QuaternionSpring* self,
+    const double times[],
+    const size_t count,
+    Quaternion out_positions[],
+    Vector3 out_velocities[]
+) {
+    const Vector3 current_velocity = self->velocity;
+    const float speed = self->speed;
+    
+    const Vector3 rotation = relative_rotation(&(self->position), &(self->target));
+    
+    float dts[SAMPLE_BLOCK_SIZE];
+    float pull_to_target[SAMPLE_BLOCK_SIZE];
+    float vel_pos_push[SAMPLE_BLOCK_SIZE];
+    float vel_push_rate[SAMPLE_BLOCK_SIZE];
+    float velocity_decay[SAMPLE_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += SAMPLE_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < SAMPLE_BLOCK_SIZE
+            ? remaining
+            : SAMPLE_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            dts[i] = speed * (float)(times[start + i] - self->_time);
+        }
+        
+        spring_coefficients(
+            self->damping, speed, dts, block,
+            pull_to_target, vel_pos_push, vel_push_rate, velocity_decay
+        );
+        
+        if (out_positions) {
+            spring_positions(
+                &(self->position), &rotation, &current_velocity,
+                pull_to_target, vel_pos_push, block, &(out_positions[start])
+            );
+        }
+        
+        if (out_velocities) {
+            for (size_t i = 0; i < block; i++) {
+                out_velocities[start + i] = spring_velocity(
+                    &rotation, &current_velocity,
+                    vel_push_rate[i], velocity_decay[i]
+                );
+            }
+        }
+    }
+}
+
+
+void quaternion_spring_group_init(
+    QuaternionSpring* storage[],
+    const size_t capacity,
+    QuaternionSpringGroup* out_group
+) {
+    out_group->springs = storage;
+    out_group->count = 0;
+    out_group->capacity = capacity;
+    out_group->active_count = 0;
+}
+
+
+int quaternion_spring_group_add(
+    QuaternionSpringGroup* self,
+    QuaternionSpring* spring
+) {
+    if (self->count >= self->capacity || spring->_group) {
+        return 0;
+    }
+    
+    const size_t index = self->count;
+    self->springs[index] = spring;
+    spring->_group = self;
+    spring->_group_index = index;
+    self->count++;
+    
+    if (!spring->sleeping) {
+        group_swap(self, index, self->active_count);
+        self->active_count++;
+    }
+    
+    return 1;
+}
+
+
+void quaternion_spring_group_remove(
+    QuaternionSpringGroup* self,
+    QuaternionSpring* spring
+) {
+    if (spring->_group != self) {
+        return;
+    }
+    
+    size_t index = spring->_group_index;
+    if (index < self->active_count) {
+        self->active_count--;
+        group_swap(self, index, self->active_count);
+        index = self->active_count;
+    }
+    
+    group_swap(self, index, self->count - 1);
+    self->count--;
+    spring->_group = NULL;
+}
+
+
+// Springs that settle are swapped out of the active range while iterating,
+// so the index only advances past springs that are still moving.
+size_t quaternion_spring_group_evaluate(
+    QuaternionSpringGroup* self
+) {
+    size_t index = 0;
+    while (index < self->active_count) {
+        QuaternionSpring* spring = self->springs[index];
+        quaternion_spring_evaluate(spring, NULL, NULL);
+        if (!spring->sleeping) {
+            index++;
+        }
+    }
+    
+    return self->active_count;
+}
@@ -1,4 +1,9 @@
+#ifndef QUATERNION_SPRING_H
+#define QUATERNION_SPRING_H
+
+#include <stddef.h>
 #include "types.h"
+#include "frame_clock.h"
 
 // Never write to struct fields directly.
 // Always call functions to update fields.
@@ -7,6 +12,16 @@
 
 //https://linux.die.net/man/3/clock_gettime
 
+// Time comes from `frame_clock` when set, otherwise from calling `clock`.
+// Sharing one FrameClock between springs avoids a clock call per access.
+
+struct QuaternionSpringGroup;
+
+// A spring sleeps once it is within `settle_epsilon` radians of its target
+// and its angular speed is below `settle_epsilon`. Sleeping springs snap to
+// the target, skip evaluation, and wake on set_target, set_position,
+// set_velocity or impulse. A `settle_epsilon` of zero never sleeps.
+
 typedef struct QuaternionSpring {
     Quaternion position;
     Quaternion target;
@@ -16,9 +31,24 @@ typedef struct QuaternionSpring {
     float speed;
     double (*clock)(void*);
     void* clock_state;
+    const FrameClock* frame_clock;
     double _time;
+    float settle_epsilon;
+    int sleeping;
+    float _settle_cos;
+    struct QuaternionSpringGroup* _group;
+    size_t _group_index;
 } QuaternionSpring;
 
+// A collection of springs that only evaluates the ones that are awake.
+// `springs[0, active_count)` are awake and the rest are sleeping.
+typedef struct QuaternionSpringGroup {
+    QuaternionSpring** springs;
+    size_t count;
+    size_t capacity;
+    size_t active_count;
+} QuaternionSpringGroup;
+
 
 static inline void quaternion_spring_new(
     const Quaternion* initial,
@@ -36,17 +66,50 @@ static inline void quaternion_spring_new(
     out_spring->speed = speed;
     out_spring->clock = clock;
     out_spring->clock_state = clock_state;
+    out_spring->frame_clock = NULL;
     out_spring->_time = clock(clock_state);
+    out_spring->settle_epsilon = 0.0f;
+    out_spring->sleeping = 0;
+    out_spring->_settle_cos = 2.0f;
+    out_spring->_group = NULL;
+    out_spring->_group_index = 0;
 }
 
-// Must call to get the latest position/velocity
+static inline void quaternion_spring_new_frame_clock(
+    const Quaternion* initial,
+    const float damping,
+    const float speed,
+    const FrameClock* frame_clock,
+    QuaternionSpring* out_spring
+) {
+    quaternion_spring_new(
+        initial, damping, speed,
+        frame_clock_read, (void*)frame_clock, out_spring
+    );
+    out_spring->frame_clock = frame_clock;
+}
+
+// The clock time the spring's functions see when called now.
+static inline double quaternion_spring_now(
+    const QuaternionSpring* self
+) {
+    return self->frame_clock
+        ? self->frame_clock->time
+        : self->clock(self->clock_state);
+}
+
+// Evaluation is memoized on the clock time: evaluating again, or calling
+// any number of setters, within the same tick costs a single evaluation.
+
+// Must call to get the latest position/velocity.
+// Updates the position and velocity fields, outputs may be NULL.
 void quaternion_spring_evaluate(
     QuaternionSpring* self,
     Quaternion* out_position,
     Vector3* out_velocity
 );
 
-// needs more testing to confirm behaviour
+// Same as quaternion_spring_evaluate without outputs.
 void quaternion_spring_evaluate_npv(
     QuaternionSpring* self
 );
@@ -83,8 +146,13 @@ void quaternion_spring_set_speed(
 
 void quaternion_spring_set_clock(
     QuaternionSpring* self,
-    const double (*clock)(void*),
-    const void* clock_state
+    double (*clock)(void*),
+    void* clock_state
+);
+
+void quaternion_spring_set_frame_clock(
+    QuaternionSpring* self,
+    const FrameClock* frame_clock
 );
 
 
@@ -106,3 +174,59 @@ void quaternion_spring_time_skip(
 );
 
 
+void quaternion_spring_set_settle_epsilon(
+    QuaternionSpring* self,
+    const float epsilon
+);
+
+
+// Snaps the spring to its target and puts it to sleep.
+void quaternion_spring_sleep(
+    QuaternionSpring* self
+);
+
+// Predicts the clock time at which the spring will be within `epsilon`
+// radians of its target with an angular speed below `epsilon`, assuming
+// no further changes. Returns HUGE_VAL if it never settles, or if epsilon
+// is not positive.
+double quaternion_spring_settle_time(
+    const QuaternionSpring* self,
+    const float epsilon
+);
+
+
+// Evaluates the spring at each of the given clock times without modifying
+// it or reading its clock. Either output may be NULL.
+void quaternion_spring_sample(
+    const QuaternionSpring* self,
+    const double times[],
+    const size_t count,
+    Quaternion out_positions[],
+    Vector3 out_velocities[]
+);
+
+
+// `storage` must have room for `capacity` spring pointers.
+void quaternion_spring_group_init(
+    QuaternionSpring* storage[],
+    const size_t capacity,
+    QuaternionSpringGroup* out_group
+);
+
+// Returns 0 if the group is full or the spring is already in a group.
+int quaternion_spring_group_add(
+    QuaternionSpringGroup* self,
+    QuaternionSpring* spring
+);
+
+void quaternion_spring_group_remove(
+    QuaternionSpringGroup* self,
+    QuaternionSpring* spring
+);
+
+// Evaluates every awake spring and returns how many are still awake.
+size_t quaternion_spring_group_evaluate(
+    QuaternionSpringGroup* self
+);
+
+#endif
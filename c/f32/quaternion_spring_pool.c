@@ -0,0 +1,166 @@
+#include "quaternion_spring_pool.h"
+
+#include <stdlib.h>
+
+
+#define FREE_LIST_END UINT32_MAX
+
+
+int quaternion_spring_pool_init(
+    QuaternionSpringPool* out_pool,
+    const size_t capacity
+) {
+    out_pool->springs = NULL;
+    out_pool->_slots = NULL;
+    out_pool->_dense = NULL;
+    out_pool->_generations = NULL;
+    out_pool->count = 0;
+    out_pool->capacity = 0;
+    out_pool->_free_head = FREE_LIST_END;
+    
+    if (capacity >= FREE_LIST_END) {
+        return 0;
+    }
+    
+    out_pool->springs = (QuaternionSpring*) malloc(
+        capacity * sizeof(QuaternionSpring)
+    );
+    out_pool->_slots = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+    out_pool->_dense = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+    out_pool->_generations = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+    
+    if (!out_pool->springs || !out_pool->_slots
+        || !out_pool->_dense || !out_pool->_generations) {
+        quaternion_spring_pool_free(out_pool);
+        return 0;
+    }
+    
+    // Generations start at 1 so a zero initialized handle is never valid.
+    for (size_t slot = 0; slot < capacity; slot++) {
+        out_pool->_dense[slot] = slot + 1 < capacity
+            ? (uint32_t)(slot + 1)
+            : FREE_LIST_END;
+        out_pool->_generations[slot] = 1;
+    }
+    out_pool->_free_head = capacity > 0 ? 0 : FREE_LIST_END;
+    out_pool->capacity = capacity;
+    
+    return 1;
+}
+
+
+void quaternion_spring_pool_free(
+    QuaternionSpringPool* self
+) {
+    free(self->springs);
+    free(self->_slots);
+    free(self->_dense);
+    free(self->_generations);
+    self->springs = NULL;
+    self->_slots = NULL;
+    self->_dense = NULL;
+    self->_generations = NULL;
+    self->count = 0;
+    self->capacity = 0;
+    self->_free_head = FREE_LIST_END;
+}
+
+
+QuaternionSpring* quaternion_spring_pool_create(
+    QuaternionSpringPool* self,
+    const Quaternion* initial,
+    const float damping,
+    const float speed,
+    double (*clock)(void*),
+    void* clock_state,
+    QuaternionSpringHandle* out_handle
+) {
+    const uint32_t slot = self->_free_head;
+    if (slot == FREE_LIST_END) {
+        return NULL;
+    }
+    
+    const uint32_t dense = (uint32_t)self->count;
+    self->_free_head = self->_dense[slot];
+    self->_dense[slot] = dense;
+    self->_slots[dense] = slot;
+    self->count++;
+    
+    QuaternionSpring* spring = &(self->springs[dense]);
+    quaternion_spring_new(initial, damping, speed, clock, clock_state, spring);
+    
+    out_handle->index = slot;
+    out_handle->generation = self->_generations[slot];
+    
+    return spring;
+}
+
+
+int quaternion_spring_pool_is_valid(
+    const QuaternionSpringPool* self,
+    const QuaternionSpringHandle handle
+) {
+    if (handle.index >= self->capacity
+        || self->_generations[handle.index] != handle.generation) {
+        return 0;
+    }
+    
+    // Free slots keep a generation too, and their _dense is a free list
+    // link, so the slot must also be the one stored at its dense index.
+    const uint32_t dense = self->_dense[handle.index];
+    return dense < self->count && self->_slots[dense] == handle.index;
+}
+
+
+int quaternion_spring_pool_destroy(
+    QuaternionSpringPool* self,
+    const QuaternionSpringHandle handle
+) {
+    // Also rejects every handle when the pool is empty.
+    if (!quaternion_spring_pool_is_valid(self, handle)) {
+        return 0;
+    }
+    
+    const uint32_t slot = handle.index;
+    const uint32_t dense = self->_dense[slot];
+    const uint32_t last = (uint32_t)(self->count - 1);
+    
+    // Swap remove, keeping the springs dense.
+    if (dense != last) {
+        const uint32_t moved_slot = self->_slots[last];
+        self->springs[dense] = self->springs[last];
+        self->_slots[dense] = moved_slot;
+        self->_dense[moved_slot] = dense;
+    }
+    self->count--;
+    
+    uint32_t generation = self->_generations[slot] + 1;
+    self->_generations[slot] = generation ? generation : 1;
+    self->_dense[slot] = self->_free_head;
+    self->_free_head = slot;
+    
+    return 1;
+}
+
+
+QuaternionSpring* quaternion_spring_pool_get(
+    const QuaternionSpringPool* self,
+    const QuaternionSpringHandle handle
+) {
+    if (!quaternion_spring_pool_is_valid(self, handle)) {
+        return NULL;
+    }
+    
+    return &(self->springs[self->_dense[handle.index]]);
+}
+
+
+void quaternion_spring_pool_evaluate(
+    QuaternionSpringPool* self
+) {
+    QuaternionSpring* springs = self->springs;
+    const size_t count = self->count;
+    for (size_t i = 0; i < count; i++) {
+        quaternion_spring_evaluate(&(springs[i]), NULL, NULL);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef QUATERNION_SPRING_POOL_H
+#define QUATERNION_SPRING_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "quaternion_spring.h"
+
+// Slot map of springs. Springs are stored densely in `springs[0, count)`
+// so batch evaluation streams through memory, and are referred to by
+// generational handles. Creating and destroying are O(1): destroying moves
+// the last spring into the freed place, and bumps the generation of the
+// handle's slot so stale handles are detected.
+//
+// Pooled springs move in memory when others are destroyed, so pointers to
+// them are only valid until the next destroy. They must not be added to a
+// QuaternionSpringGroup or SpringTimerWheel, which keep pointers.
+//
+// Never write to struct fields directly.
+// It's ok to read `springs` and `count`.
+
+typedef struct QuaternionSpringHandle {
+    uint32_t index;
+    uint32_t generation;
+} QuaternionSpringHandle;
+
+// Never valid, compares equal to a zero initialized handle.
+static const QuaternionSpringHandle QUATERNION_SPRING_HANDLE_NULL = {0, 0};
+
+typedef struct QuaternionSpringPool {
+    QuaternionSpring* springs;
+    size_t count;
+    size_t capacity;
+    // Slot of each dense spring.
+    uint32_t* _slots;
+    // Dense index of each slot, or the next free slot for free slots.
+    uint32_t* _dense;
+    uint32_t* _generations;
+    uint32_t _free_head;
+} QuaternionSpringPool;
+
+
+// Returns 0 if the allocation failed.
+int quaternion_spring_pool_init(
+    QuaternionSpringPool* out_pool,
+    const size_t capacity
+);
+
+void quaternion_spring_pool_free(
+    QuaternionSpringPool* self
+);
+
+// Creates a spring as quaternion_spring_new would, and returns it or NULL
+// if the pool is full.
+QuaternionSpring* quaternion_spring_pool_create(
+    QuaternionSpringPool* self,
+    const Quaternion* initial,
+    const float damping,
+    const float speed,
+    double (*clock)(void*),
+    void* clock_state,
+    QuaternionSpringHandle* out_handle
+);
+
+// Returns 0 if the handle is stale.
+int quaternion_spring_pool_destroy(
+    QuaternionSpringPool* self,
+    const QuaternionSpringHandle handle
+);
+
+// Returns NULL if the handle is stale.
+QuaternionSpring* quaternion_spring_pool_get(
+    const QuaternionSpringPool* self,
+    const QuaternionSpringHandle handle
+);
+
+int quaternion_spring_pool_is_valid(
+    const QuaternionSpringPool* self,
+    const QuaternionSpringHandle handle
+);
+
+// Evaluates every spring in the pool, in memory order.
+void quaternion_spring_pool_evaluate(
+    QuaternionSpringPool* self
+);
+
+#endif
@@ -0,0 +1,276 @@
+#include "quaternion_track.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "quaternion.h"
+#include "quaternion_spline.h"
+
+
+#define MAX_THREADS 64
+
+
+typedef struct ReduceJob {
+    QuaternionTrack* tracks;
+    size_t count;
+    float tolerance;
+    QuaternionTrackReconstruction reconstruction;
+    // Index of the next track to hand out, and the failures so far.
+    size_t next;
+    size_t failed_count;
+} ReduceJob;
+
+
+// Angle of the rotation between q0 and q1, the same for q and -q.
+static inline float rotation_angle(
+    const Quaternion* q0,
+    const Quaternion* q1
+) {
+    const Quaternion inverse = quaternion_conjugate(q0);
+    const Quaternion difference = quaternion_mul(&inverse, q1);
+    const float sine = sqrtf(
+        difference.x * difference.x
+        + difference.y * difference.y
+        + difference.z * difference.z
+    );
+    return 2.0f * atan2f(sine, fabsf(difference.w));
+}
+
+
+static void keep_every_sample(
+    QuaternionTrack* track
+) {
+    for (size_t i = 0; i < track->count; i++) {
+        track->kept[i] = i;
+    }
+    track->kept_count = track->count;
+    track->max_error = 0.0f;
+}
+
+
+static void slerp_segment_errors(
+    const QuaternionTrack* track,
+    float out_errors[],
+    size_t out_worst[]
+) {
+    for (size_t k = 0; k + 1 < track->kept_count; k++) {
+        const size_t first = track->kept[k];
+        const size_t last = track->kept[k + 1];
+        const double duration = track->times[last] - track->times[first];
+        
+        struct SlerpState slerp_state;
+        quaternion_slerp_function_init(
+            &(track->samples[first]), &(track->samples[last]), &slerp_state
+        );
+        
+        out_errors[k] = 0.0f;
+        out_worst[k] = first;
+        for (size_t i = first + 1; i < last; i++) {
+            const float u = (float)(
+                (track->times[i] - track->times[first]) / duration
+            );
+            const Quaternion reconstructed = quaternion_slerp_function(
+                &slerp_state, u
+            );
+            const float error = rotation_angle(&reconstructed, &(track->samples[i]));
+            if (error > out_errors[k]) {
+                out_errors[k] = error;
+                out_worst[k] = i;
+            }
+        }
+    }
+}
+
+
+// Returns 0 if the curve could not be allocated.
+static int squad_segment_errors(
+    const QuaternionTrack* track,
+    Quaternion keys[],
+    double key_times[],
+    float out_errors[],
+    size_t out_worst[]
+) {
+    for (size_t k = 0; k < track->kept_count; k++) {
+        keys[k] = track->samples[track->kept[k]];
+        key_times[k] = track->times[track->kept[k]];
+    }
+    
+    QuaternionSquad curve;
+    if (!quaternion_squad_init(&curve, keys, key_times, track->kept_count)) {
+        return 0;
+    }
+    
+    for (size_t k = 0; k + 1 < track->kept_count; k++) {
+        const size_t first = track->kept[k];
+        const size_t last = track->kept[k + 1];
+        
+        out_errors[k] = 0.0f;
+        out_worst[k] = first;
+        for (size_t i = first + 1; i < last; i++) {
+            const Quaternion reconstructed = quaternion_squad_evaluate(
+                &curve, track->times[i]
+            );
+            const float error = rotation_angle(&reconstructed, &(track->samples[i]));
+            if (error > out_errors[k]) {
+                out_errors[k] = error;
+                out_worst[k] = i;
+            }
+        }
+    }
+    
+    quaternion_squad_free(&curve);
+    return 1;
+}
+
+
+int quaternion_track_reduce(
+    QuaternionTrack* track,
+    const float tolerance,
+    const QuaternionTrackReconstruction reconstruction
+) {
+    const size_t count = track->count;
+    if (count <= 2) {
+        keep_every_sample(track);
+        return 1;
+    }
+    
+    // Per segment worst errors and their samples, and for SQUAD the kept
+    // keys gathered for the curve.
+    float* errors = (float*) malloc(count * sizeof(float));
+    size_t* worst = (size_t*) malloc(count * sizeof(size_t));
+    Quaternion* keys = NULL;
+    double* key_times = NULL;
+    if (reconstruction == QUATERNION_TRACK_SQUAD) {
+        keys = (Quaternion*) malloc(count * sizeof(Quaternion));
+        key_times = (double*) malloc(count * sizeof(double));
+    }
+    
+    int success = errors && worst
+        && (reconstruction != QUATERNION_TRACK_SQUAD || (keys && key_times));
+    
+    size_t* kept = track->kept;
+    kept[0] = 0;
+    kept[1] = count - 1;
+    track->kept_count = 2;
+    
+    while (success) {
+        if (reconstruction == QUATERNION_TRACK_SQUAD) {
+            success = squad_segment_errors(track, keys, key_times, errors, worst);
+            if (!success) {
+                break;
+            }
+        } else {
+            slerp_segment_errors(track, errors, worst);
+        }
+        
+        const size_t segment_count = track->kept_count - 1;
+        size_t inserted = 0;
+        float max_error = 0.0f;
+        for (size_t k = 0; k < segment_count; k++) {
+            inserted += errors[k] > tolerance;
+            max_error = errors[k] > max_error ? errors[k] : max_error;
+        }
+        
+        if (inserted == 0) {
+            track->max_error = max_error;
+            break;
+        }
+        
+        // Merged in place from the back, since the kept keys only move up.
+        size_t write = track->kept_count + inserted;
+        kept[--write] = kept[segment_count];
+        for (size_t k = segment_count; k-- > 0;) {
+            if (errors[k] > tolerance) {
+                kept[--write] = worst[k];
+            }
+            kept[--write] = kept[k];
+        }
+        track->kept_count += inserted;
+    }
+    
+    free(errors);
+    free(worst);
+    free(keys);
+    free(key_times);
+    
+    if (!success) {
+        keep_every_sample(track);
+    }
+    return success;
+}
+
+
+static void* reduce_worker(
+    void* argument
+) {
+    ReduceJob* job = (ReduceJob*) argument;
+    
+    for (;;) {
+        const size_t i = __atomic_fetch_add(&(job->next), 1, __ATOMIC_RELAXED);
+        if (i >= job->count) {
+            break;
+        }
+        
+        if (!quaternion_track_reduce(
+            &(job->tracks[i]), job->tolerance, job->reconstruction
+        )) {
+            __atomic_fetch_add(&(job->failed_count), 1, __ATOMIC_RELAXED);
+        }
+    }
+    
+    return NULL;
+}
+
+
+void quaternion_tracks_reduce(
+    QuaternionTrack tracks[],
+    const size_t count,
+    const float tolerance,
+    const QuaternionTrackReconstruction reconstruction,
+    const size_t thread_count,
+    QuaternionTrackReport* out_report
+) {
+    ReduceJob job = {
+        .tracks = tracks,
+        .count = count,
+        .tolerance = tolerance,
+        .reconstruction = reconstruction,
+        .next = 0,
+        .failed_count = 0
+    };
+    
+    // The calling thread is one of the workers.
+    size_t helper_count = thread_count < count ? thread_count : count;
+    helper_count = helper_count > MAX_THREADS ? MAX_THREADS : helper_count;
+    helper_count = helper_count > 0 ? helper_count - 1 : 0;
+    
+    pthread_t helpers[MAX_THREADS];
+    size_t started = 0;
+    while (started < helper_count) {
+        if (pthread_create(&(helpers[started]), NULL, reduce_worker, &job) != 0) {
+            break;
+        }
+        started++;
+    }
+    
+    reduce_worker(&job);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(helpers[i], NULL);
+    }
+    
+    out_report->sample_count = 0;
+    out_report->key_count = 0;
+    out_report->max_error = 0.0f;
+    out_report->failed_count = job.failed_count;
+    for (size_t i = 0; i < count; i++) {
+        out_report->sample_count += tracks[i].count;
+        out_report->key_count += tracks[i].kept_count;
+        if (tracks[i].max_error > out_report->max_error) {
+            out_report->max_error = tracks[i].max_error;
+        }
+    }
+    out_report->compression_ratio = out_report->key_count > 0
+        ? (float) out_report->sample_count / (float) out_report->key_count
+        : 1.0f;
+}
@@ -0,0 +1,73 @@
+#ifndef QUATERNION_TRACK_H
+#define QUATERNION_TRACK_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Offline keyframe reduction of dense orientation tracks. The reducer keeps
+// a subset of the samples such that playing the kept keys back reproduces
+// every dropped sample within an angular tolerance.
+//
+// Keys are chosen top down: starting from the end samples, each segment
+// whose worst sample is out of tolerance gets that sample as a new key,
+// and the reconstruction is repeated until every segment is within
+// tolerance. The error is the symmetric geodesic distance, the angle in
+// radians of the rotation between the sample and the reconstruction.
+
+// How the kept keys are played back. The reconstruction is evaluated at
+// the sample times with the parameter linear in time between keys.
+typedef enum QuaternionTrackReconstruction {
+    // quaternion_slerp between neighbouring keys.
+    QUATERNION_TRACK_SLERP,
+    // A QuaternionSquad through the keys.
+    QUATERNION_TRACK_SQUAD
+} QuaternionTrackReconstruction;
+
+// The samples and times are read only. `kept` is written by the reducer
+// and must have room for `count` indices.
+typedef struct QuaternionTrack {
+    const Quaternion* samples;
+    const double* times;
+    size_t count;
+    // Increasing indices of the kept samples, always including the first
+    // and last.
+    size_t* kept;
+    size_t kept_count;
+    // Largest error over the dropped samples, in radians.
+    float max_error;
+} QuaternionTrack;
+
+typedef struct QuaternionTrackReport {
+    size_t sample_count;
+    size_t key_count;
+    // sample_count / key_count
+    float compression_ratio;
+    float max_error;
+    // Tracks that could not allocate their reconstruction, and kept every
+    // sample.
+    size_t failed_count;
+} QuaternionTrackReport;
+
+
+// Fills `kept`, `kept_count` and `max_error`. `times` must be increasing.
+// Returns 0 if the allocation failed, in which case every sample is kept.
+int quaternion_track_reduce(
+    QuaternionTrack* track,
+    const float tolerance,
+    const QuaternionTrackReconstruction reconstruction
+);
+
+// Reduces every track, spreading the tracks over `thread_count` threads
+// including the calling one. Tracks are handed out one at a time, so a
+// few long tracks do not leave the other threads idle. If a thread cannot
+// be started, the remaining threads take over its share.
+void quaternion_tracks_reduce(
+    QuaternionTrack tracks[],
+    const size_t count,
+    const float tolerance,
+    const QuaternionTrackReconstruction reconstruction,
+    const size_t thread_count,
+    QuaternionTrackReport* out_report
+);
+
+#endif
@@ -0,0 +1,253 @@
+#include "quaternion_validate.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+#include "quaternion.h"
+
+
+#define EXPONENT_BITS 0x7f800000u
+#define MANTISSA_BITS 0x007fffffu
+#define MAGNITUDE_BITS 0x7fffffffu
+#define MASK_WIDTH 64
+
+
+static inline unsigned int component_defects(
+    const float value
+) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t exponent = bits & EXPONENT_BITS;
+    
+    if (exponent == EXPONENT_BITS) {
+        return QUATERNION_NOT_FINITE;
+    }
+    if (exponent == 0 && (bits & MANTISSA_BITS) != 0) {
+        return QUATERNION_DENORMAL;
+    }
+    return 0;
+}
+
+
+static inline Quaternion flush_denormals(
+    const Quaternion* q0
+) {
+    return quaternion_new(
+        component_defects(q0->x) == QUATERNION_DENORMAL ? 0.0f : q0->x,
+        component_defects(q0->y) == QUATERNION_DENORMAL ? 0.0f : q0->y,
+        component_defects(q0->z) == QUATERNION_DENORMAL ? 0.0f : q0->z,
+        component_defects(q0->w) == QUATERNION_DENORMAL ? 0.0f : q0->w
+    );
+}
+
+
+#if defined(__SSE2__)
+// Accumulates the lanes of `bits` that are not finite, and those with a
+// zero exponent but a non-zero magnitude.
+static inline void classify_lanes(
+    const __m128i bits,
+    __m128i* not_finite,
+    __m128i* denormal
+) {
+    const __m128i exponent_bits = _mm_set1_epi32((int) EXPONENT_BITS);
+    const __m128i magnitude_bits = _mm_set1_epi32((int) MAGNITUDE_BITS);
+    const __m128i zero = _mm_setzero_si128();
+    
+    const __m128i exponent = _mm_and_si128(bits, exponent_bits);
+    const __m128i magnitude = _mm_and_si128(bits, magnitude_bits);
+    *not_finite = _mm_or_si128(
+        *not_finite, _mm_cmpeq_epi32(exponent, exponent_bits)
+    );
+    *denormal = _mm_or_si128(*denormal, _mm_andnot_si128(
+        _mm_cmpeq_epi32(magnitude, zero), _mm_cmpeq_epi32(exponent, zero)
+    ));
+}
+#endif
+
+
+// Bits of the elements of q[0, count) with any of the `checks`, for count
+// at most MASK_WIDTH.
+static uint64_t scan_block(
+    const Quaternion q[],
+    const size_t count,
+    const float tolerance,
+    const unsigned int checks
+) {
+    uint64_t mask = 0;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 magnitude_bits = _mm_castsi128_ps(
+        _mm_set1_epi32((int) MAGNITUDE_BITS)
+    );
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 tolerances = _mm_set1_ps(tolerance);
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(&(q[i].x));
+        __m128 y = _mm_loadu_ps(&(q[i + 1].x));
+        __m128 z = _mm_loadu_ps(&(q[i + 2].x));
+        __m128 w = _mm_loadu_ps(&(q[i + 3].x));
+        // One lane per quaternion.
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        
+        __m128 flagged = _mm_setzero_ps();
+        
+        if (checks & (QUATERNION_NOT_FINITE | QUATERNION_DENORMAL)) {
+            __m128i not_finite = zero;
+            __m128i denormal = zero;
+            classify_lanes(_mm_castps_si128(x), &not_finite, &denormal);
+            classify_lanes(_mm_castps_si128(y), &not_finite, &denormal);
+            classify_lanes(_mm_castps_si128(z), &not_finite, &denormal);
+            classify_lanes(_mm_castps_si128(w), &not_finite, &denormal);
+            
+            if (checks & QUATERNION_NOT_FINITE) {
+                flagged = _mm_or_ps(flagged, _mm_castsi128_ps(not_finite));
+            }
+            if (checks & QUATERNION_DENORMAL) {
+                flagged = _mm_or_ps(flagged, _mm_castsi128_ps(denormal));
+            }
+        }
+        
+        if (checks & QUATERNION_NOT_UNIT) {
+            const __m128 length_squared = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))
+            );
+            const __m128 error = _mm_and_ps(
+                _mm_sub_ps(length_squared, one), magnitude_bits
+            );
+            // Not less or equal, so NaN lengths are flagged too.
+            flagged = _mm_or_ps(flagged, _mm_cmpnle_ps(error, tolerances));
+        }
+        
+        mask |= (uint64_t) _mm_movemask_ps(flagged) << i;
+    }
+#endif
+
+    for (; i < count; i++) {
+        if (quaternion_defects(&(q[i]), tolerance, checks)) {
+            mask |= (uint64_t) 1 << i;
+        }
+    }
+    
+    return mask;
+}
+
+
+unsigned int quaternion_defects(
+    const Quaternion* q0,
+    const float tolerance,
+    const unsigned int checks
+) {
+    unsigned int defects = component_defects(q0->x)
+        | component_defects(q0->y)
+        | component_defects(q0->z)
+        | component_defects(q0->w);
+    
+    if (checks & QUATERNION_NOT_UNIT) {
+        const float length_squared = q0->x * q0->x + q0->y * q0->y
+            + q0->z * q0->z + q0->w * q0->w;
+        if (!(fabsf(length_squared - 1.0f) <= tolerance)) {
+            defects |= QUATERNION_NOT_UNIT;
+        }
+    }
+    
+    return defects & checks;
+}
+
+
+size_t quaternion_validate_mask(
+    const Quaternion q[],
+    const size_t count,
+    const float tolerance,
+    const unsigned int checks,
+    uint64_t out_mask[]
+) {
+    size_t flagged = 0;
+    
+    for (size_t start = 0; start < count; start += MASK_WIDTH) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < MASK_WIDTH ? remaining : MASK_WIDTH;
+        
+        const uint64_t mask = scan_block(&(q[start]), block, tolerance, checks);
+        out_mask[start / MASK_WIDTH] = mask;
+        flagged += (size_t) __builtin_popcountll(mask);
+    }
+    
+    return flagged;
+}
+
+
+size_t quaternion_validate_indices(
+    const Quaternion q[],
+    const size_t count,
+    const float tolerance,
+    const unsigned int checks,
+    size_t out_indices[],
+    const size_t capacity
+) {
+    size_t flagged = 0;
+    
+    for (size_t start = 0; start < count; start += MASK_WIDTH) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < MASK_WIDTH ? remaining : MASK_WIDTH;
+        
+        uint64_t mask = scan_block(&(q[start]), block, tolerance, checks);
+        while (mask) {
+            if (flagged < capacity) {
+                out_indices[flagged] = start + (size_t) __builtin_ctzll(mask);
+            }
+            flagged++;
+            mask &= mask - 1;
+        }
+    }
+    
+    return flagged;
+}
+
+
+size_t quaternion_sanitize(
+    Quaternion q[],
+    const size_t count,
+    const float tolerance,
+    const unsigned int checks,
+    const QuaternionFixup fixup
+) {
+    size_t fixed = 0;
+    
+    for (size_t start = 0; start < count; start += MASK_WIDTH) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < MASK_WIDTH ? remaining : MASK_WIDTH;
+        
+        uint64_t mask = scan_block(&(q[start]), block, tolerance, checks);
+        while (mask) {
+            Quaternion* element = &(q[start + (size_t) __builtin_ctzll(mask)]);
+            mask &= mask - 1;
+            fixed++;
+            
+            const unsigned int defects = quaternion_defects(
+                element, tolerance, QUATERNION_ALL_DEFECTS
+            );
+            if (fixup == QUATERNION_FIXUP_IDENTITY
+                || (defects & QUATERNION_NOT_FINITE)) {
+                *element = QUATERNION_IDENTITY;
+                continue;
+            }
+            
+            const Quaternion flushed = flush_denormals(element);
+            const Quaternion unit = quaternion_normalize_scaled(&flushed);
+            // Dividing by the length can make small components denormal
+            // again, and flushing them changes the length by far less than
+            // an ulp.
+            *element = flush_denormals(&unit);
+        }
+    }
+    
+    return fixed;
+}
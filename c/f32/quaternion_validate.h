@@ -0,0 +1,73 @@
+#ifndef QUATERNION_VALIDATE_H
+#define QUATERNION_VALIDATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+// Validation of Quaternion arrays from untrusted or numerically drifting
+// sources, cheap enough to leave on: arrays are scanned four quaternions
+// at a time with SSE2, testing the bits of the exponents rather than
+// calling fpclassify, and the elements that pass are never touched again.
+// Only flagged elements are looked at one by one.
+//
+// Unit length is tested on the squared length, |x^2 + y^2 + z^2 + w^2 - 1|
+// <= tolerance, so a tolerance of 2e-6 allows a length error of about
+// 1e-6. Elements that are not finite also fail it.
+
+// Defects, as bit flags. `checks` arguments select which to look for.
+#define QUATERNION_NOT_FINITE 1u
+#define QUATERNION_NOT_UNIT 2u
+#define QUATERNION_DENORMAL 4u
+#define QUATERNION_ALL_DEFECTS 7u
+
+typedef enum QuaternionFixup {
+    // Denormal components are flushed to zero and the result renormalized,
+    // with the identity for elements that are not finite or have zero
+    // length.
+    QUATERNION_FIXUP_RENORMALIZE,
+    // Every flagged element is replaced with the identity.
+    QUATERNION_FIXUP_IDENTITY
+} QuaternionFixup;
+
+
+// The defects of one quaternion, among `checks`.
+unsigned int quaternion_defects(
+    const Quaternion* q0,
+    const float tolerance,
+    const unsigned int checks
+);
+
+// Sets bit i % 64 of out_mask[i / 64] for each element i with any of the
+// `checks`, and clears the others. `out_mask` must have room for
+// (count + 63) / 64 words. Returns the number of flagged elements.
+size_t quaternion_validate_mask(
+    const Quaternion q[],
+    const size_t count,
+    const float tolerance,
+    const unsigned int checks,
+    uint64_t out_mask[]
+);
+
+// Writes the indices of the flagged elements in increasing order, up to
+// `capacity` of them. Returns the number of flagged elements, which may be
+// more than were written.
+size_t quaternion_validate_indices(
+    const Quaternion q[],
+    const size_t count,
+    const float tolerance,
+    const unsigned int checks,
+    size_t out_indices[],
+    const size_t capacity
+);
+
+// Fixes the flagged elements in place. Returns the number fixed.
+size_t quaternion_sanitize(
+    Quaternion q[],
+    const size_t count,
+    const float tolerance,
+    const unsigned int checks,
+    const QuaternionFixup fixup
+);
+
+#endif
@@ -0,0 +1,63 @@
+#include "radian_spring.h"
+
+#include <math.h>
+
+#define M_DEFINE_CONSTANTS
+#include "math_util.h"
+
+
+// ((x + tau) mod 2tau) - tau with a floored modulo, into [-tau, tau).
+static inline float wrap_angle(
+    const float x
+) {
+    return x - (float)(2 * TAU) * floorf((x + (float)TAU) * (float)(1 / (2 * TAU)));
+}
+
+
+static inline float radian_spring_difference(
+    const float* target,
+    const float* position
+) {
+    return wrap_angle(*target - *position);
+}
+
+static inline float radian_spring_madd(
+    const float a,
+    const float b,
+    const float scale
+) {
+    return a + b * scale;
+}
+
+static inline float radian_spring_scale(
+    const float a,
+    const float scale
+) {
+    return a * scale;
+}
+
+static inline float radian_spring_wrap(
+    const float position
+) {
+    return wrap_angle(position);
+}
+
+static inline float radian_spring_component(
+    const float* value,
+    const size_t index
+) {
+    (void)index;
+    return *value;
+}
+
+static inline void radian_spring_set_component(
+    float* value,
+    const size_t index,
+    const float x
+) {
+    (void)index;
+    *value = x;
+}
+
+
+SPRING_DEFINE(RadianSpring, radian_spring, float, RADIAN_SPRING_LANES, 1)
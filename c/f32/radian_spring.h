@@ -0,0 +1,19 @@
+#ifndef RADIAN_SPRING_H
+#define RADIAN_SPRING_H
+
+#include "spring.h"
+
+// Spring for an angle in radians, see spring.h for the generated functions.
+//
+// Assigned positions are wrapped into [-2pi, 2pi), and the spring moves
+// along the difference to the target wrapped into the same range. This
+// "double cover" lets the caller choose the direction an angle travels in
+// by adding or subtracting 2pi. The target starts at the initial angle, set
+// it to 0 to spring angles towards 0.
+// Its lanes need a `wrap` array in SpringLanes.
+
+#define RADIAN_SPRING_LANES 1
+
+SPRING_DECLARE(RadianSpring, radian_spring, float)
+
+#endif
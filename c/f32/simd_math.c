@@ -0,0 +1,501 @@
+#include "simd_math.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+
+// The kernels below are written once against a small set of lane
+// operations. Masks are lanes with all bits set or clear, and v_select
+// picks from `a` where the mask is set.
+
+#if SIMD_MATH_LANES == 8
+    #include <immintrin.h>
+    
+    typedef __m256 vfloat;
+    typedef __m256i vint;
+    
+    #define v_load _mm256_loadu_ps
+    #define v_store _mm256_storeu_ps
+    #define v_set _mm256_set1_ps
+    #define v_add _mm256_add_ps
+    #define v_sub _mm256_sub_ps
+    #define v_mul _mm256_mul_ps
+    #define v_div _mm256_div_ps
+    #define v_min _mm256_min_ps
+    #define v_max _mm256_max_ps
+    #define v_sqrt _mm256_sqrt_ps
+    #define v_rsqrt_estimate _mm256_rsqrt_ps
+    #define v_and _mm256_and_ps
+    #define v_xor _mm256_xor_ps
+    #define v_lt(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+    #define v_gt(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+    #define v_select(mask, a, b) _mm256_blendv_ps(b, a, mask)
+    #define v_round_int _mm256_cvtps_epi32
+    #define v_from_int _mm256_cvtepi32_ps
+    #define v_from_bits _mm256_castsi256_ps
+    #define vi_set _mm256_set1_epi32
+    #define vi_add _mm256_add_epi32
+    #define vi_sub _mm256_sub_epi32
+    #define vi_and _mm256_and_si256
+    #define vi_shift_left _mm256_slli_epi32
+    #define vi_half(a) _mm256_srai_epi32(a, 1)
+    #define vi_eq(a, b) _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))
+    #ifdef __FMA__
+        #define v_madd(a, b, c) _mm256_fmadd_ps(a, b, c)
+    #else
+        #define v_madd(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+    #endif
+#elif SIMD_MATH_LANES == 4
+    #include <emmintrin.h>
+    
+    typedef __m128 vfloat;
+    typedef __m128i vint;
+    
+    #define v_load _mm_loadu_ps
+    #define v_store _mm_storeu_ps
+    #define v_set _mm_set1_ps
+    #define v_add _mm_add_ps
+    #define v_sub _mm_sub_ps
+    #define v_mul _mm_mul_ps
+    #define v_div _mm_div_ps
+    #define v_min _mm_min_ps
+    #define v_max _mm_max_ps
+    #define v_sqrt _mm_sqrt_ps
+    #define v_rsqrt_estimate _mm_rsqrt_ps
+    #define v_and _mm_and_ps
+    #define v_xor _mm_xor_ps
+    #define v_lt _mm_cmplt_ps
+    #define v_gt _mm_cmpgt_ps
+    #define v_select(mask, a, b) \
+        _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))
+    #define v_round_int _mm_cvtps_epi32
+    #define v_from_int _mm_cvtepi32_ps
+    #define v_from_bits _mm_castsi128_ps
+    #define vi_set _mm_set1_epi32
+    #define vi_add _mm_add_epi32
+    #define vi_sub _mm_sub_epi32
+    #define vi_and _mm_and_si128
+    #define vi_shift_left _mm_slli_epi32
+    #define vi_half(a) _mm_srai_epi32(a, 1)
+    #define vi_eq(a, b) _mm_castsi128_ps(_mm_cmpeq_epi32(a, b))
+    #define v_madd(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#else
+    typedef float vfloat;
+    typedef uint32_t vint;
+    
+    static inline vfloat v_from_bits(const vint bits) {
+        vfloat x;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+    
+    static inline vint v_to_bits(const vfloat x) {
+        vint bits;
+        memcpy(&bits, &x, sizeof(bits));
+        return bits;
+    }
+    
+    static inline vfloat v_mask(const int condition) {
+        return v_from_bits(condition ? 0xFFFFFFFFu : 0);
+    }
+    
+    // Like the SSE instructions, min and max return `b` if either is NaN.
+    static inline vfloat v_min(const vfloat a, const vfloat b) {
+        return a < b ? a : b;
+    }
+    
+    static inline vfloat v_max(const vfloat a, const vfloat b) {
+        return a > b ? a : b;
+    }
+    
+    static inline vfloat v_rsqrt_estimate(const vfloat x) {
+        const vfloat estimate = v_from_bits(0x5F375A86u - (v_to_bits(x) >> 1));
+        return estimate * (1.5f - 0.5f * x * estimate * estimate);
+    }
+    
+    static inline vfloat v_and(const vfloat a, const vfloat b) {
+        return v_from_bits(v_to_bits(a) & v_to_bits(b));
+    }
+    
+    static inline vfloat v_xor(const vfloat a, const vfloat b) {
+        return v_from_bits(v_to_bits(a) ^ v_to_bits(b));
+    }
+    
+    static inline vfloat v_select(const vfloat mask, const vfloat a, const vfloat b) {
+        return v_to_bits(mask) ? a : b;
+    }
+    
+    static inline vint v_round_int(const vfloat x) {
+        return fabsf(x) < 2147483520.0f
+            ? (vint)(int32_t)floorf(x + 0.5f)
+            : 0x80000000u;
+    }
+    
+    static inline vfloat v_from_int(const vint a) {
+        return (vfloat)(int32_t)a;
+    }
+    
+    #define v_load(p) (*(p))
+    #define v_store(p, a) (*(p) = (a))
+    #define v_set(x) ((vfloat)(x))
+    #define v_add(a, b) ((a) + (b))
+    #define v_sub(a, b) ((a) - (b))
+    #define v_mul(a, b) ((a) * (b))
+    #define v_div(a, b) ((a) / (b))
+    #define v_sqrt sqrtf
+    #define v_lt(a, b) v_mask((a) < (b))
+    #define v_gt(a, b) v_mask((a) > (b))
+    #define vi_set(x) ((vint)(x))
+    #define vi_add(a, b) ((a) + (b))
+    #define vi_sub(a, b) ((a) - (b))
+    #define vi_half(a) ((vint)((int32_t)(a) / 2))
+    #define vi_and(a, b) ((a) & (b))
+    #define vi_shift_left(a, n) ((a) << (n))
+    #define vi_eq(a, b) v_mask((a) == (b))
+    #define v_madd(a, b, c) ((a) * (b) + (c))
+#endif
+
+
+#define SIGN_MASK v_set(-0.0f)
+#define ABS_MASK v_from_bits(vi_set(0x7FFFFFFF))
+
+#define PI_F 3.14159265358979323846f
+#define HALF_PI_F 1.57079632679489661923f
+#define QUARTER_PI_F 0.78539816339744830962f
+
+// pi / 2 split so that k * PIO2_1 and k * PIO2_2 are exact for the integer
+// multiples k used in the range reduction.
+#define PIO2_1 1.5703125f
+#define PIO2_2 4.837512969970703125e-4f
+#define PIO2_3 7.54978995489188216e-8f
+
+#define LOG2E_F 1.44269504088896341f
+#define LN2_HI 0.693359375f
+#define LN2_LO -2.12194440e-4f
+
+#define EXP_OVERFLOW 88.7228391f
+#define EXP_UNDERFLOW -87.3365448f
+
+
+// Polynomial coefficients. The precise ones are the minimax fits of the
+// Cephes library, the fast ones are least squares fits of lower degree.
+
+static inline void sincos_lanes(
+    const vfloat x,
+    const int precise,
+    vfloat* out_sin,
+    vfloat* out_cos
+) {
+    // x = k * pi / 2 + r, with r in [-pi / 4, pi / 4].
+    const vint k = v_round_int(v_mul(x, v_set((float)(2 / 3.14159265358979323846))));
+    const vfloat kf = v_from_int(k);
+    vfloat r = v_madd(kf, v_set(-PIO2_1), x);
+    r = v_madd(kf, v_set(-PIO2_2), r);
+    r = v_madd(kf, v_set(-PIO2_3), r);
+    const vfloat z = v_mul(r, r);
+    
+    vfloat sin_poly, cos_poly;
+    if (precise) {
+        sin_poly = v_madd(z, v_set(-1.9515295891e-4f), v_set(8.3321608736e-3f));
+        sin_poly = v_madd(z, sin_poly, v_set(-1.6666654611e-1f));
+        cos_poly = v_madd(z, v_set(2.443315711809948e-5f), v_set(-1.388731625493765e-3f));
+        cos_poly = v_madd(z, cos_poly, v_set(4.166664568298827e-2f));
+        cos_poly = v_madd(z, cos_poly, v_set(-0.5f));
+    } else {
+        sin_poly = v_madd(z, v_set(8.1623033e-3f), v_set(-1.6663338e-1f));
+        cos_poly = v_madd(z, v_set(4.0451581e-2f), v_set(-4.9975680e-1f));
+    }
+    const vfloat s = v_madd(v_mul(r, z), sin_poly, r);
+    const vfloat c = v_madd(z, cos_poly, v_set(1.0f));
+    
+    // Odd quadrants swap sine and cosine, and the sign of the sine flips
+    // in quadrants 2 and 3, that of the cosine in quadrants 1 and 2.
+    const vfloat swap = vi_eq(vi_and(k, vi_set(1)), vi_set(1));
+    const vfloat sin_sign = v_from_bits(vi_shift_left(vi_and(k, vi_set(2)), 30));
+    const vfloat cos_sign = v_from_bits(
+        vi_shift_left(vi_and(vi_add(k, vi_set(1)), vi_set(2)), 30)
+    );
+    *out_sin = v_xor(v_select(swap, c, s), sin_sign);
+    *out_cos = v_xor(v_select(swap, s, c), cos_sign);
+}
+
+
+static inline vfloat exp_lanes(
+    const vfloat x,
+    const int precise
+) {
+    // Constants first, so NaN inputs pass through min and max.
+    const vfloat clamped = v_max(v_set(EXP_UNDERFLOW), v_min(v_set(EXP_OVERFLOW), x));
+    
+    // x = n * ln 2 + r, with r in [-ln 2 / 2, ln 2 / 2].
+    const vint n = v_round_int(v_mul(clamped, v_set(LOG2E_F)));
+    const vfloat nf = v_from_int(n);
+    vfloat r = v_madd(nf, v_set(-LN2_HI), clamped);
+    r = v_madd(nf, v_set(-LN2_LO), r);
+    
+    vfloat p;
+    if (precise) {
+        p = v_madd(r, v_set(1.9875691500e-4f), v_set(1.3981999507e-3f));
+        p = v_madd(r, p, v_set(8.3334519073e-3f));
+        p = v_madd(r, p, v_set(4.1665795894e-2f));
+        p = v_madd(r, p, v_set(1.6666665459e-1f));
+        p = v_madd(r, p, v_set(5.0000001201e-1f));
+        p = v_madd(v_mul(r, r), p, v_add(r, v_set(1.0f)));
+    } else {
+        p = v_madd(r, v_set(1.6393028e-1f), v_set(5.0414469e-1f));
+        p = v_madd(r, p, v_set(1.0003194f));
+        p = v_madd(r, p, v_set(1.0f));
+    }
+    
+    // 2^n in two factors, as n = 128 has no float exponent of its own.
+    const vint n_low = vi_half(n);
+    const vint n_high = vi_sub(n, n_low);
+    const vfloat scale_low = v_from_bits(vi_shift_left(vi_add(n_low, vi_set(127)), 23));
+    const vfloat scale_high = v_from_bits(vi_shift_left(vi_add(n_high, vi_set(127)), 23));
+    vfloat result = v_mul(v_mul(p, scale_low), scale_high);
+    result = v_select(v_gt(x, v_set(EXP_OVERFLOW)), v_set(HUGE_VALF), result);
+    return v_select(v_lt(x, v_set(EXP_UNDERFLOW)), v_set(0.0f), result);
+}
+
+
+static inline vfloat acos_lanes(
+    const vfloat x,
+    const int precise
+) {
+    const vfloat clamped = v_max(v_set(-1.0f), v_min(v_set(1.0f), x));
+    const vfloat sign = v_and(clamped, SIGN_MASK);
+    const vfloat a = v_and(clamped, ABS_MASK);
+    
+    // Above 1/2, asin(a) = pi / 2 - 2 asin(sqrt((1 - a) / 2)).
+    const vfloat big = v_gt(a, v_set(0.5f));
+    const vfloat z = v_select(big, v_mul(v_set(0.5f), v_sub(v_set(1.0f), a)), v_mul(a, a));
+    const vfloat s = v_select(big, v_sqrt(z), a);
+    
+    vfloat p;
+    if (precise) {
+        p = v_madd(z, v_set(4.2163199048e-2f), v_set(2.4181311049e-2f));
+        p = v_madd(z, p, v_set(4.5470025998e-2f));
+        p = v_madd(z, p, v_set(7.4953002686e-2f));
+        p = v_madd(z, p, v_set(1.6666752422e-1f));
+    } else {
+        p = v_madd(z, v_set(9.3951314e-2f), v_set(1.6513057e-1f));
+    }
+    const vfloat asin_s = v_madd(v_mul(s, z), p, s);
+    
+    const vfloat twice = v_add(asin_s, asin_s);
+    const vfloat big_result = v_select(
+        v_lt(clamped, v_set(0.0f)), v_sub(v_set(PI_F), twice), twice
+    );
+    const vfloat small_result = v_sub(v_set(HALF_PI_F), v_xor(asin_s, sign));
+    return v_select(big, big_result, small_result);
+}
+
+
+static inline vfloat atan2_lanes(
+    const vfloat y,
+    const vfloat x,
+    const int precise
+) {
+    const vfloat ay = v_and(y, ABS_MASK);
+    const vfloat ax = v_and(x, ABS_MASK);
+    const vfloat numerator = v_min(ay, ax);
+    const vfloat denominator = v_max(ay, ax);
+    const vfloat a = v_select(
+        v_gt(denominator, v_set(0.0f)),
+        v_div(numerator, denominator),
+        v_set(0.0f)
+    );
+    
+    // atan(a) for a in [0, 1].
+    vfloat result;
+    if (precise) {
+        // Above tan(pi / 8), atan(a) = pi / 4 + atan((a - 1) / (a + 1)).
+        const vfloat big = v_gt(a, v_set(0.41421356237f));
+        const vfloat t = v_select(
+            big, v_div(v_sub(a, v_set(1.0f)), v_add(a, v_set(1.0f))), a
+        );
+        const vfloat z = v_mul(t, t);
+        vfloat p = v_madd(z, v_set(8.05374449538e-2f), v_set(-1.38776856032e-1f));
+        p = v_madd(z, p, v_set(1.99777106478e-1f));
+        p = v_madd(z, p, v_set(-3.33329491539e-1f));
+        result = v_madd(v_mul(t, z), p, t);
+        result = v_add(result, v_and(big, v_set(QUARTER_PI_F)));
+    } else {
+        const vfloat z = v_mul(a, a);
+        vfloat p = v_madd(z, v_set(2.4681148e-2f), v_set(-9.3808829e-2f));
+        p = v_madd(z, p, v_set(1.8666186e-1f));
+        p = v_madd(z, p, v_set(-3.3211024e-1f));
+        result = v_madd(v_mul(a, z), p, a);
+    }
+    
+    result = v_select(v_gt(ay, ax), v_sub(v_set(HALF_PI_F), result), result);
+    result = v_select(v_lt(x, v_set(0.0f)), v_sub(v_set(PI_F), result), result);
+    return v_xor(result, v_and(y, SIGN_MASK));
+}
+
+
+static inline vfloat rsqrt_lanes(
+    const vfloat x,
+    const int precise
+) {
+    if (precise) {
+        return v_div(v_set(1.0f), v_sqrt(x));
+    }
+    
+    // One Newton step: e * (1.5 - 0.5 * x * e * e).
+    const vfloat estimate = v_rsqrt_estimate(x);
+    const vfloat half_x_e = v_mul(v_mul(v_set(0.5f), x), estimate);
+    return v_mul(estimate, v_sub(v_set(1.5f), v_mul(half_x_e, estimate)));
+}
+
+
+// The last partial group is padded with a value that is valid input. The
+// lanes are gathered in registers rather than through a buffer, which would
+// stall the vector load on the scalar stores.
+
+static inline vfloat load_partial(
+    const float x[],
+    const size_t count,
+    const float padding
+) {
+    #if SIMD_MATH_LANES == 8
+        const vint mask = _mm256_cmpgt_epi32(
+            vi_set((int)count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)
+        );
+        return v_select(
+            _mm256_castsi256_ps(mask), _mm256_maskload_ps(x, mask), v_set(padding)
+        );
+    #elif SIMD_MATH_LANES == 4
+        return _mm_setr_ps(
+            x[0],
+            count > 1 ? x[1] : padding,
+            count > 2 ? x[2] : padding,
+            padding
+        );
+    #else
+        (void)count;
+        (void)padding;
+        return x[0];
+    #endif
+}
+
+
+static inline void store_partial(
+    float out[],
+    const size_t count,
+    const vfloat value
+) {
+    float lanes[SIMD_MATH_LANES];
+    v_store(lanes, value);
+    for (size_t i = 0; i < count; i++) {
+        out[i] = lanes[i];
+    }
+}
+
+
+void simd_sincos(
+    const float x[],
+    const size_t count,
+    float out_sin[],
+    float out_cos[],
+    const SimdMathAccuracy accuracy
+) {
+    const int precise = accuracy == SIMD_MATH_PRECISE;
+    vfloat s, c;
+    
+    size_t i = 0;
+    for (; i + SIMD_MATH_LANES <= count; i += SIMD_MATH_LANES) {
+        sincos_lanes(v_load(&(x[i])), precise, &s, &c);
+        v_store(&(out_sin[i]), s);
+        v_store(&(out_cos[i]), c);
+    }
+    
+    if (i < count) {
+        sincos_lanes(load_partial(&(x[i]), count - i, 0.0f), precise, &s, &c);
+        store_partial(&(out_sin[i]), count - i, s);
+        store_partial(&(out_cos[i]), count - i, c);
+    }
+}
+
+
+void simd_exp(
+    const float x[],
+    const size_t count,
+    float out[],
+    const SimdMathAccuracy accuracy
+) {
+    const int precise = accuracy == SIMD_MATH_PRECISE;
+    
+    size_t i = 0;
+    for (; i + SIMD_MATH_LANES <= count; i += SIMD_MATH_LANES) {
+        v_store(&(out[i]), exp_lanes(v_load(&(x[i])), precise));
+    }
+    
+    if (i < count) {
+        const vfloat lanes = load_partial(&(x[i]), count - i, 0.0f);
+        store_partial(&(out[i]), count - i, exp_lanes(lanes, precise));
+    }
+}
+
+
+void simd_acos(
+    const float x[],
+    const size_t count,
+    float out[],
+    const SimdMathAccuracy accuracy
+) {
+    const int precise = accuracy == SIMD_MATH_PRECISE;
+    
+    size_t i = 0;
+    for (; i + SIMD_MATH_LANES <= count; i += SIMD_MATH_LANES) {
+        v_store(&(out[i]), acos_lanes(v_load(&(x[i])), precise));
+    }
+    
+    if (i < count) {
+        const vfloat lanes = load_partial(&(x[i]), count - i, 1.0f);
+        store_partial(&(out[i]), count - i, acos_lanes(lanes, precise));
+    }
+}
+
+
+void simd_atan2(
+    const float y[],
+    const float x[],
+    const size_t count,
+    float out[],
+    const SimdMathAccuracy accuracy
+) {
+    const int precise = accuracy == SIMD_MATH_PRECISE;
+    
+    size_t i = 0;
+    for (; i + SIMD_MATH_LANES <= count; i += SIMD_MATH_LANES) {
+        v_store(&(out[i]), atan2_lanes(v_load(&(y[i])), v_load(&(x[i])), precise));
+    }
+    
+    if (i < count) {
+        const vfloat y_lanes = load_partial(&(y[i]), count - i, 0.0f);
+        const vfloat x_lanes = load_partial(&(x[i]), count - i, 1.0f);
+        store_partial(&(out[i]), count - i, atan2_lanes(y_lanes, x_lanes, precise));
+    }
+}
+
+
+void simd_rsqrt(
+    const float x[],
+    const size_t count,
+    float out[],
+    const SimdMathAccuracy accuracy
+) {
+    const int precise = accuracy == SIMD_MATH_PRECISE;
+    
+    size_t i = 0;
+    for (; i + SIMD_MATH_LANES <= count; i += SIMD_MATH_LANES) {
+        v_store(&(out[i]), rsqrt_lanes(v_load(&(x[i])), precise));
+    }
+    
+    if (i < count) {
+        const vfloat lanes = load_partial(&(x[i]), count - i, 1.0f);
+        store_partial(&(out[i]), count - i, rsqrt_lanes(lanes, precise));
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <stddef.h>
+
+// Vectorized transcendentals over float arrays, shared by the batch kernels
+// so each does not call scalar libm per element. Elements are processed
+// SIMD_MATH_LANES at a time: 8 with AVX2, 4 with SSE2, and one at a time
+// with the same polynomials elsewhere. The last partial group is padded,
+// so an element's result never depends on its position in the array.
+//
+// Outputs may alias inputs of the same length, element for element.
+
+#if defined(__AVX2__)
+    #define SIMD_MATH_LANES 8
+#elif defined(__SSE2__)
+    #define SIMD_MATH_LANES 4
+#else
+    #define SIMD_MATH_LANES 1
+#endif
+
+typedef enum SimdMathAccuracy {
+    // Shorter polynomials, relative error below 2e-4 (absolute for acos
+    // and atan2), and rsqrt from the hardware estimate and one Newton step.
+    SIMD_MATH_FAST,
+    // Within a few ulp of libm.
+    SIMD_MATH_PRECISE
+} SimdMathAccuracy;
+
+
+// Arguments are reduced exactly for |x| up to about 8192, beyond which the
+// error grows gradually, to about 1e-6 at 1e5.
+void simd_sincos(
+    const float x[],
+    const size_t count,
+    float out_sin[],
+    float out_cos[],
+    const SimdMathAccuracy accuracy
+);
+
+// Underflows to 0 below the smallest normal float, overflows to infinity.
+void simd_exp(
+    const float x[],
+    const size_t count,
+    float out[],
+    const SimdMathAccuracy accuracy
+);
+
+// Inputs are clamped to [-1, 1].
+void simd_acos(
+    const float x[],
+    const size_t count,
+    float out[],
+    const SimdMathAccuracy accuracy
+);
+
+// atan2(0, 0) is 0.
+void simd_atan2(
+    const float y[],
+    const float x[],
+    const size_t count,
+    float out[],
+    const SimdMathAccuracy accuracy
+);
+
+// 1 / sqrt(x), for positive x.
+void simd_rsqrt(
+    const float x[],
+    const size_t count,
+    float out[],
+    const SimdMathAccuracy accuracy
+);
+
+#endif
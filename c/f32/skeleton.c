@@ -0,0 +1,263 @@
+#include "skeleton.h"
+
+#include <stdlib.h>
+
+
+int skeleton_is_sorted(
+    const int* parents,
+    const size_t joint_count
+) {
+    for (size_t joint = 0; joint < joint_count; joint++) {
+        const int parent = parents[joint];
+        if (parent >= 0 && (size_t)parent >= joint) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+
+int skeleton_topology_init(
+    const int* parents,
+    const size_t joint_count,
+    SkeletonTopology* out_topology
+) {
+    if (!skeleton_is_sorted(parents, joint_count)) {
+        return 0;
+    }
+    
+    out_topology->parents = parents;
+    out_topology->joint_count = joint_count;
+    return 1;
+}
+
+
+// Places every joint whose parent has already been placed, one pass per level
+// of the hierarchy. This is an offline step, so O(joints * depth) is fine.
+int skeleton_sort(
+    const int* parents,
+    const size_t joint_count,
+    int out_order[],
+    int out_parents[]
+) {
+    int* new_index = (int*) malloc(joint_count * sizeof(int));
+    if (!new_index) {
+        return 0;
+    }
+    
+    for (size_t joint = 0; joint < joint_count; joint++) {
+        const int parent = parents[joint];
+        if (parent >= 0 && (size_t)parent >= joint_count) {
+            free(new_index);
+            return 0;
+        }
+        new_index[joint] = -1;
+    }
+    
+    size_t placed = 0;
+    while (placed < joint_count) {
+        const size_t placed_before = placed;
+        
+        for (size_t joint = 0; joint < joint_count; joint++) {
+            const int parent = parents[joint];
+            if (new_index[joint] < 0 && (parent < 0 || new_index[parent] >= 0)) {
+                new_index[joint] = (int)placed;
+                out_order[placed] = (int)joint;
+                placed++;
+            }
+        }
+        
+        if (placed == placed_before) {
+            free(new_index);
+            return 0;
+        }
+    }
+    
+    for (size_t joint = 0; joint < joint_count; joint++) {
+        const int parent = parents[out_order[joint]];
+        out_parents[joint] = parent < 0 ? -1 : new_index[parent];
+    }
+    
+    free(new_index);
+    return 1;
+}
+
+
+void skeleton_local_to_world(
+    const SkeletonTopology* topology,
+    const SkeletonPose* local,
+    SkeletonPose* out_world
+) {
+    skeleton_local_to_world_batch(topology, local, 1, out_world);
+}
+
+
+void skeleton_world_to_local(
+    const SkeletonTopology* topology,
+    const SkeletonPose* world,
+    SkeletonPose* out_local
+) {
+    skeleton_world_to_local_batch(topology, world, 1, out_local);
+}
+
+
+static inline void copy_joint(
+    const SkeletonPose* src,
+    SkeletonPose* dst,
+    const int has_position,
+    const size_t offset,
+    const size_t count
+) {
+    for (size_t i = offset; i < offset + count; i++) {
+        dst->qx[i] = src->qx[i];
+        dst->qy[i] = src->qy[i];
+        dst->qz[i] = src->qz[i];
+        dst->qw[i] = src->qw[i];
+    }
+    
+    if (!has_position) {
+        return;
+    }
+    
+    for (size_t i = offset; i < offset + count; i++) {
+        dst->px[i] = src->px[i];
+        dst->py[i] = src->py[i];
+        dst->pz[i] = src->pz[i];
+    }
+}
+
+
+// Joints are processed in index order, so every parent is final before its
+// children read it. Within a joint the loops run over instances, which are
+// independent of each other and contiguous in memory.
+void skeleton_local_to_world_batch(
+    const SkeletonTopology* topology,
+    const SkeletonPose* local,
+    const size_t instance_count,
+    SkeletonPose* out_world
+) {
+    const int* parents = topology->parents;
+    const size_t joint_count = topology->joint_count;
+    const int has_position = local->px && out_world->px;
+    
+    for (size_t joint = 0; joint < joint_count; joint++) {
+        const int parent = parents[joint];
+        const size_t j0 = joint * instance_count;
+        
+        if (parent < 0) {
+            if (local != out_world) {
+                copy_joint(local, out_world, has_position, j0, instance_count);
+            }
+            continue;
+        }
+        
+        const size_t p0 = (size_t)parent * instance_count;
+        
+        for (size_t i = 0; i < instance_count; i++) {
+            const float ax = out_world->qx[p0 + i];
+            const float ay = out_world->qy[p0 + i];
+            const float az = out_world->qz[p0 + i];
+            const float aw = out_world->qw[p0 + i];
+            const float bx = local->qx[j0 + i];
+            const float by = local->qy[j0 + i];
+            const float bz = local->qz[j0 + i];
+            const float bw = local->qw[j0 + i];
+            
+            out_world->qx[j0 + i] = aw * bx + ax * bw + ay * bz - az * by;
+            out_world->qy[j0 + i] = aw * by - ax * bz + ay * bw + az * bx;
+            out_world->qz[j0 + i] = aw * bz + ax * by - ay * bx + az * bw;
+            out_world->qw[j0 + i] = aw * bw - ax * bx - ay * by - az * bz;
+        }
+        
+        if (!has_position) {
+            continue;
+        }
+        
+        for (size_t i = 0; i < instance_count; i++) {
+            const float qx = out_world->qx[p0 + i];
+            const float qy = out_world->qy[p0 + i];
+            const float qz = out_world->qz[p0 + i];
+            const float qw = out_world->qw[p0 + i];
+            const float vx = local->px[j0 + i];
+            const float vy = local->py[j0 + i];
+            const float vz = local->pz[j0 + i];
+            
+            const float tx = 2.0f * (qy * vz - qz * vy);
+            const float ty = 2.0f * (qz * vx - qx * vz);
+            const float tz = 2.0f * (qx * vy - qy * vx);
+            
+            out_world->px[j0 + i] = out_world->px[p0 + i]
+                + vx + qw * tx + (qy * tz - qz * ty);
+            out_world->py[j0 + i] = out_world->py[p0 + i]
+                + vy + qw * ty + (qz * tx - qx * tz);
+            out_world->pz[j0 + i] = out_world->pz[p0 + i]
+                + vz + qw * tz + (qx * ty - qy * tx);
+        }
+    }
+}
+
+
+// Joints are processed in reverse index order so that, when converting in
+// place, a parent's world transform is still intact when its children read it.
+void skeleton_world_to_local_batch(
+    const SkeletonTopology* topology,
+    const SkeletonPose* world,
+    const size_t instance_count,
+    SkeletonPose* out_local
+) {
+    const int* parents = topology->parents;
+    const size_t joint_count = topology->joint_count;
+    const int has_position = world->px && out_local->px;
+    
+    for (size_t joint = joint_count; joint-- > 0;) {
+        const int parent = parents[joint];
+        const size_t j0 = joint * instance_count;
+        
+        if (parent < 0) {
+            if (world != out_local) {
+                copy_joint(world, out_local, has_position, j0, instance_count);
+            }
+            continue;
+        }
+        
+        const size_t p0 = (size_t)parent * instance_count;
+        
+        if (has_position) {
+            for (size_t i = 0; i < instance_count; i++) {
+                // Rotate by the conjugate of the parent rotation.
+                const float qx = -world->qx[p0 + i];
+                const float qy = -world->qy[p0 + i];
+                const float qz = -world->qz[p0 + i];
+                const float qw = world->qw[p0 + i];
+                const float vx = world->px[j0 + i] - world->px[p0 + i];
+                const float vy = world->py[j0 + i] - world->py[p0 + i];
+                const float vz = world->pz[j0 + i] - world->pz[p0 + i];
+                
+                const float tx = 2.0f * (qy * vz - qz * vy);
+                const float ty = 2.0f * (qz * vx - qx * vz);
+                const float tz = 2.0f * (qx * vy - qy * vx);
+                
+                out_local->px[j0 + i] = vx + qw * tx + (qy * tz - qz * ty);
+                out_local->py[j0 + i] = vy + qw * ty + (qz * tx - qx * tz);
+                out_local->pz[j0 + i] = vz + qw * tz + (qx * ty - qy * tx);
+            }
+        }
+        
+        for (size_t i = 0; i < instance_count; i++) {
+            const float ax = -world->qx[p0 + i];
+            const float ay = -world->qy[p0 + i];
+            const float az = -world->qz[p0 + i];
+            const float aw = world->qw[p0 + i];
+            const float bx = world->qx[j0 + i];
+            const float by = world->qy[j0 + i];
+            const float bz = world->qz[j0 + i];
+            const float bw = world->qw[j0 + i];
+            
+            out_local->qx[j0 + i] = aw * bx + ax * bw + ay * bz - az * by;
+            out_local->qy[j0 + i] = aw * by - ax * bz + ay * bw + az * bx;
+            out_local->qz[j0 + i] = aw * bz + ax * by - ay * bx + az * bw;
+            out_local->qw[j0 + i] = aw * bw - ax * bx - ay * by - az * bz;
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Joints are stored in topological order: the parent of a joint always has a
+// lower index than the joint itself, and root joints have a parent of -1.
+// Propagation is then a single forward pass over linear arrays.
+
+typedef struct SkeletonTopology {
+    const int* parents;
+    size_t joint_count;
+} SkeletonTopology;
+
+// Structure of arrays holding the rotation (and optionally the position) of
+// every joint. Set the position arrays to NULL for rotation only poses.
+//
+// Batch functions use the same struct for many instances sharing a topology,
+// stored joint major: joint `j` of instance `i` is at `j * instance_count + i`.
+typedef struct SkeletonPose {
+    float* qx;
+    float* qy;
+    float* qz;
+    float* qw;
+    float* px;
+    float* py;
+    float* pz;
+} SkeletonPose;
+
+
+// Returns 1 if every parent index is -1 or lower than its joint's index.
+int skeleton_is_sorted(
+    const int* parents,
+    const size_t joint_count
+);
+
+// Returns 0 without writing to `out_topology` if `parents` is not sorted.
+// The topology keeps a pointer to `parents`, it is not copied.
+int skeleton_topology_init(
+    const int* parents,
+    const size_t joint_count,
+    SkeletonTopology* out_topology
+);
+
+// Computes a topological order for an unsorted parent array.
+// `out_order[new_index]` is the old index of the joint, and `out_parents`
+// receives the parent array remapped to the new indices.
+// Returns 0 if the hierarchy has a cycle or an out of range parent.
+int skeleton_sort(
+    const int* parents,
+    const size_t joint_count,
+    int out_order[],
+    int out_parents[]
+);
+
+
+// `out_world` may be the same pose as `local`.
+void skeleton_local_to_world(
+    const SkeletonTopology* topology,
+    const SkeletonPose* local,
+    SkeletonPose* out_world
+);
+
+// `out_local` may be the same pose as `world`.
+void skeleton_world_to_local(
+    const SkeletonTopology* topology,
+    const SkeletonPose* world,
+    SkeletonPose* out_local
+);
+
+void skeleton_local_to_world_batch(
+    const SkeletonTopology* topology,
+    const SkeletonPose* local,
+    const size_t instance_count,
+    SkeletonPose* out_world
+);
+
+void skeleton_world_to_local_batch(
+    const SkeletonTopology* topology,
+    const SkeletonPose* world,
+    const size_t instance_count,
+    SkeletonPose* out_local
+);
+
+#endif
@@ -0,0 +1,202 @@
+#include "snapshot_interpolator.h"
+
+#include <math.h>
+
+#include "quaternion.h"
+#include "vector3.h"
+
+
+#define INDEX_MASK (SNAPSHOT_INTERPOLATOR_CAPACITY - 1)
+#define BATCH_BLOCK_SIZE 64
+// Gain of the smoothed transit time, jitter and interval.
+#define SMOOTHING (1.0 / 16.0)
+
+
+// Moves the delay towards its target by the time elapsed since the last
+// sample.
+static void adapt_delay(
+    SnapshotInterpolator* self,
+    const double now
+) {
+    const double elapsed = now > self->_last_now ? now - self->_last_now : 0.0;
+    const double step = self->_adapt_rate * elapsed;
+    const double target = self->_interval + self->_jitter_multiplier * self->jitter;
+    const double change = target - self->delay;
+    
+    self->delay += change > step ? step : change < -step ? -step : change;
+    self->_last_now = now;
+}
+
+
+// The snapshot before the playout time of `now`, and the velocity and time
+// to integrate it with.
+static const Quaternion* playout(
+    const SnapshotInterpolator* self,
+    const double now,
+    const Vector3** out_velocity,
+    float* out_elapsed
+) {
+    const double time = now - self->_offset - self->delay;
+    size_t index = self->_newest;
+    
+    if (time >= self->_times[index]) {
+        const double elapsed = time - self->_times[index];
+        *out_velocity = &(self->_velocities[index]);
+        *out_elapsed = (float)(
+            elapsed < self->_max_extrapolation ? elapsed : self->_max_extrapolation
+        );
+        return &(self->_rotations[index]);
+    }
+    
+    // Usually only a few snapshots back.
+    for (size_t i = 1; i < self->count; i++) {
+        const size_t next = index;
+        index = (index - 1) & INDEX_MASK;
+        if (time >= self->_times[index]) {
+            *out_velocity = &(self->_velocities[next]);
+            *out_elapsed = (float)(time - self->_times[index]);
+            return &(self->_rotations[index]);
+        }
+    }
+    
+    // Before the oldest snapshot, which is held.
+    *out_velocity = &(self->_velocities[index]);
+    *out_elapsed = 0.0f;
+    return &(self->_rotations[index]);
+}
+
+
+void snapshot_interpolator_init(
+    SnapshotInterpolator* out_interpolator,
+    const double jitter_multiplier,
+    const double adapt_rate,
+    const double max_extrapolation
+) {
+    out_interpolator->delay = 0.0;
+    out_interpolator->jitter = 0.0;
+    out_interpolator->count = 0;
+    out_interpolator->_jitter_multiplier = jitter_multiplier;
+    out_interpolator->_adapt_rate = adapt_rate;
+    out_interpolator->_max_extrapolation = max_extrapolation;
+    out_interpolator->_offset = 0.0;
+    out_interpolator->_last_transit = 0.0;
+    out_interpolator->_interval = 0.0;
+    out_interpolator->_last_now = 0.0;
+    out_interpolator->_newest = 0;
+}
+
+
+void snapshot_interpolator_receive(
+    SnapshotInterpolator* self,
+    const double send_time,
+    const double arrival_time,
+    const Quaternion* rotation
+) {
+    const double transit = arrival_time - send_time;
+    const Quaternion unit_rotation = quaternion_normalize(rotation);
+    
+    if (self->count == 0) {
+        self->_offset = transit;
+        self->_last_transit = transit;
+        self->_last_now = arrival_time;
+        self->_times[0] = send_time;
+        self->_rotations[0] = unit_rotation;
+        self->_velocities[0] = VECTOR3_ZERO;
+        self->count = 1;
+        return;
+    }
+    
+    const size_t previous = self->_newest;
+    const double interval = send_time - self->_times[previous];
+    if (interval <= 0) {
+        return;
+    }
+    
+    self->jitter += (fabs(transit - self->_last_transit) - self->jitter) * SMOOTHING;
+    self->_last_transit = transit;
+    self->_offset += (transit - self->_offset) * SMOOTHING;
+    if (self->count == 1) {
+        // The first interval sets the delay, which only adapts after that.
+        self->_interval = interval;
+        self->delay = interval;
+    } else {
+        self->_interval += (interval - self->_interval) * SMOOTHING;
+    }
+    
+    const size_t newest = (previous + 1) & INDEX_MASK;
+    self->_newest = newest;
+    self->_times[newest] = send_time;
+    self->_rotations[newest] = unit_rotation;
+    self->_velocities[newest] = quaternion_angular_velocity(
+        &(self->_rotations[previous]), &unit_rotation, (float) interval
+    );
+    if (self->count < SNAPSHOT_INTERPOLATOR_CAPACITY) {
+        self->count++;
+    }
+}
+
+
+Quaternion snapshot_interpolator_sample(
+    SnapshotInterpolator* self,
+    const double now
+) {
+    if (self->count == 0) {
+        return QUATERNION_IDENTITY;
+    }
+    
+    adapt_delay(self, now);
+    
+    const Vector3* velocity;
+    float elapsed;
+    const Quaternion* base = playout(self, now, &velocity, &elapsed);
+    return quaternion_integrate(base, velocity, elapsed);
+}
+
+
+// quaternion_integrate is base exp(velocity elapsed / 2), so the
+// exponentials of every entity in a block are evaluated together.
+void snapshot_interpolator_sample_batch(
+    SnapshotInterpolator interpolators[],
+    const size_t count,
+    const double now,
+    Quaternion out[]
+) {
+    const Quaternion* bases[BATCH_BLOCK_SIZE];
+    Quaternion steps[BATCH_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += BATCH_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < BATCH_BLOCK_SIZE
+            ? remaining
+            : BATCH_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            SnapshotInterpolator* interpolator = &(interpolators[start + i]);
+            if (interpolator->count == 0) {
+                bases[i] = &QUATERNION_IDENTITY;
+                steps[i] = quaternion_new(0.0f, 0.0f, 0.0f, 0.0f);
+                continue;
+            }
+            
+            adapt_delay(interpolator, now);
+            
+            const Vector3* velocity;
+            float elapsed;
+            bases[i] = playout(interpolator, now, &velocity, &elapsed);
+            const float half_elapsed = 0.5f * elapsed;
+            steps[i] = quaternion_new(
+                velocity->x * half_elapsed,
+                velocity->y * half_elapsed,
+                velocity->z * half_elapsed,
+                0.0f
+            );
+        }
+        
+        quaternion_exp_batch(steps, block, steps);
+        
+        for (size_t i = 0; i < block; i++) {
+            const Quaternion result = quaternion_mul(bases[i], &(steps[i]));
+            out[start + i] = quaternion_normalize(&result);
+        }
+    }
+}
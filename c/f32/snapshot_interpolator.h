@@ -0,0 +1,84 @@
+#ifndef SNAPSHOT_INTERPOLATOR_H
+#define SNAPSHOT_INTERPOLATOR_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Playout of an entity's orientation snapshots received over the network.
+// Snapshots carry the sender's time, and are played back at a delay behind
+// the sender's clock so that the snapshot after the playout time has
+// usually arrived, slerping between the two around it.
+//
+// The delay adapts to the network: it aims at the mean interval between
+// snapshots plus `jitter_multiplier` times the smoothed variation of their
+// transit times (as in RFC 3550), and moves towards that target at most
+// `adapt_rate` seconds per second, so playback speeds up or slows down
+// slightly rather than jumping. When the next snapshot is late, the last
+// one is extrapolated with its angular velocity, for at most
+// `max_extrapolation` seconds.
+//
+// Each snapshot stores the angular velocity from the one before it, so
+// interpolating and extrapolating are both a quaternion_integrate from
+// the snapshot before the playout time.
+//
+// Never write to struct fields directly.
+// It's ok to read `delay`, `jitter` and `count`.
+
+// Snapshots kept per entity, a power of 2.
+#define SNAPSHOT_INTERPOLATOR_CAPACITY 16
+
+typedef struct SnapshotInterpolator {
+    double delay;
+    double jitter;
+    size_t count;
+    double _jitter_multiplier;
+    double _adapt_rate;
+    double _max_extrapolation;
+    // Smoothed transit time, receiver's clock minus sender's, and the last
+    // transit time.
+    double _offset;
+    double _last_transit;
+    // Smoothed interval between snapshots.
+    double _interval;
+    double _last_now;
+    // Ring of snapshots by sender time, _newest being the last received.
+    size_t _newest;
+    double _times[SNAPSHOT_INTERPOLATOR_CAPACITY];
+    Quaternion _rotations[SNAPSHOT_INTERPOLATOR_CAPACITY];
+    Vector3 _velocities[SNAPSHOT_INTERPOLATOR_CAPACITY];
+} SnapshotInterpolator;
+
+
+void snapshot_interpolator_init(
+    SnapshotInterpolator* out_interpolator,
+    const double jitter_multiplier,
+    const double adapt_rate,
+    const double max_extrapolation
+);
+
+// `send_time` is the sender's clock, `arrival_time` the receiver's.
+// Snapshots not newer than the last one received are dropped.
+void snapshot_interpolator_receive(
+    SnapshotInterpolator* self,
+    const double send_time,
+    const double arrival_time,
+    const Quaternion* rotation
+);
+
+// The orientation to show at the receiver's time `now`, which should not
+// decrease between calls. The identity if no snapshot has been received.
+Quaternion snapshot_interpolator_sample(
+    SnapshotInterpolator* self,
+    const double now
+);
+
+// Samples every entity in one pass, with the rotations for all of them
+// evaluated together by the simd_math functions.
+void snapshot_interpolator_sample_batch(
+    SnapshotInterpolator interpolators[],
+    const size_t count,
+    const double now,
+    Quaternion out[]
+);
+
+#endif
@@ -0,0 +1,256 @@
+#include "spring.h"
+
+#include <math.h>
+#include <string.h>
+
+#define M_DEFINE_CONSTANTS
+#include "math_util.h"
+#include "simd_math.h"
+
+
+#define LANE_BLOCK_SIZE 64
+
+
+// Coefficients of the closed form solution for each speed scaled elapsed
+// time in `dts`. The damping regime is chosen once for the whole array, so
+// each loop is straight line code over the samples, and the exponentials
+// and sines go through the vectorized simd_math functions.
+// concern: floats may not provide enough accuracy for expf
+void spring_coefficients(
+    const float damping,
+    const float speed,
+    const float dts[],
+    const size_t count,
+    float out_pull_to_target[],
+    float out_vel_pos_push[],
+    float out_vel_push_rate[],
+    float out_velocity_decay[]
+) {
+    const float damping_squared = damping * damping;
+    
+    // sin_theta and cos_theta are staged in the push and decay outputs, and
+    // the exponential arguments in the other two.
+    float* sin_thetas = out_vel_pos_push;
+    float* cos_thetas = out_velocity_decay;
+    float* exponentials = out_pull_to_target;
+    float* other_exponentials = out_vel_push_rate;
+    
+    float ang_freq;
+    if (damping_squared < 1) {
+        ang_freq = sqrtf(1 - damping_squared);
+        float* angles = other_exponentials;
+        for (size_t i = 0; i < count; i++) {
+            exponentials[i] = fmaxf(-damping * dts[i], SPRING_EXP_FLOOR);
+            angles[i] = ang_freq * dts[i];
+        }
+        simd_exp(exponentials, count, exponentials, SIMD_MATH_PRECISE);
+        simd_sincos(angles, count, sin_thetas, cos_thetas, SIMD_MATH_PRECISE);
+        
+        const float inv_ang_freq = 1 / ang_freq;
+        for (size_t i = 0; i < count; i++) {
+            const float exponential = exponentials[i] * inv_ang_freq;
+            sin_thetas[i] *= exponential;
+            cos_thetas[i] *= exponential;
+        }
+    } else if (damping_squared == 1) {
+        ang_freq = 1;
+        for (size_t i = 0; i < count; i++) {
+            exponentials[i] = fmaxf(-damping * dts[i], SPRING_EXP_FLOOR);
+        }
+        simd_exp(exponentials, count, exponentials, SIMD_MATH_PRECISE);
+        
+        for (size_t i = 0; i < count; i++) {
+            sin_thetas[i] = exponentials[i] * dts[i];
+            cos_thetas[i] = exponentials[i];
+        }
+    } else {
+        ang_freq = sqrtf(damping_squared - 1);
+        const float m_damping = -damping;
+        for (size_t i = 0; i < count; i++) {
+            const float dt = dts[i];
+            exponentials[i] = fmaxf((m_damping + ang_freq) * dt, SPRING_EXP_FLOOR);
+            other_exponentials[i] = fmaxf((m_damping - ang_freq) * dt, SPRING_EXP_FLOOR);
+        }
+        simd_exp(exponentials, count, exponentials, SIMD_MATH_PRECISE);
+        simd_exp(other_exponentials, count, other_exponentials, SIMD_MATH_PRECISE);
+        
+        const float ang_freq_2 = 1 / (2 * ang_freq);
+        for (size_t i = 0; i < count; i++) {
+            const float u = exponentials[i] * ang_freq_2;
+            const float v = other_exponentials[i] * ang_freq_2;
+            sin_thetas[i] = u - v;
+            cos_thetas[i] = u + v;
+        }
+    }
+    
+    const float inv_speed = 1 / speed;
+    for (size_t i = 0; i < count; i++) {
+        const float sin_theta = sin_thetas[i];
+        const float cos_theta = cos_thetas[i];
+        out_pull_to_target[i] = 1 - spring_flush(
+            ang_freq * cos_theta + damping * sin_theta
+        );
+        out_vel_pos_push[i] = spring_flush(sin_theta * inv_speed);
+        out_vel_push_rate[i] = spring_flush(speed * sin_theta);
+        out_velocity_decay[i] = spring_flush(
+            ang_freq * cos_theta - damping * sin_theta
+        );
+    }
+}
+
+
+// Per element regimes, with the same formulas as spring_coefficients. Each
+// block stages the arguments of every regime, evaluates the exponentials
+// and sines together, then combines them per element.
+void spring_coefficients_mixed(
+    const float dampings[],
+    const float speeds[],
+    const float dts[],
+    const size_t count,
+    float out_pull_to_target[],
+    float out_vel_pos_push[],
+    float out_vel_push_rate[],
+    float out_velocity_decay[]
+) {
+    float ang_freqs[LANE_BLOCK_SIZE];
+    float exponentials[LANE_BLOCK_SIZE];
+    float other_exponentials[LANE_BLOCK_SIZE];
+    float angles[LANE_BLOCK_SIZE];
+    float sines[LANE_BLOCK_SIZE];
+    float cosines[LANE_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += LANE_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < LANE_BLOCK_SIZE
+            ? remaining
+            : LANE_BLOCK_SIZE;
+        
+        int any_under = 0;
+        int any_over = 0;
+        for (size_t i = 0; i < block; i++) {
+            const float damping = dampings[start + i];
+            const float dt = dts[start + i];
+            const float damping_squared = damping * damping;
+            const int under = damping_squared < 1;
+            const int over = damping_squared > 1;
+            const float root = sqrtf(fabsf(1 - damping_squared));
+            const float ang_freq = under | over ? root : 1;
+            
+            ang_freqs[i] = ang_freq;
+            exponentials[i] = fmaxf(
+                (over ? ang_freq - damping : -damping) * dt, SPRING_EXP_FLOOR
+            );
+            other_exponentials[i] = fmaxf((-damping - ang_freq) * dt, SPRING_EXP_FLOOR);
+            angles[i] = under ? ang_freq * dt : 0;
+            any_under |= under;
+            any_over |= over;
+        }
+        
+        simd_exp(exponentials, block, exponentials, SIMD_MATH_PRECISE);
+        if (any_over) {
+            simd_exp(other_exponentials, block, other_exponentials, SIMD_MATH_PRECISE);
+        }
+        if (any_under) {
+            simd_sincos(angles, block, sines, cosines, SIMD_MATH_PRECISE);
+        } else {
+            memset(sines, 0, block * sizeof(float));
+            memset(cosines, 0, block * sizeof(float));
+        }
+        
+        // Every regime is computed and selected, keeping the loop branch free.
+        for (size_t i = 0; i < block; i++) {
+            const size_t element = start + i;
+            const float damping = dampings[element];
+            const float speed = speeds[element];
+            const float damping_squared = damping * damping;
+            const float ang_freq = ang_freqs[i];
+            const float inv_ang_freq = 1 / ang_freq;
+            const float u = exponentials[i];
+            const float v = other_exponentials[i];
+            
+            const float under_scale = u * inv_ang_freq;
+            const float under_sin = under_scale * sines[i];
+            const float under_cos = under_scale * cosines[i];
+            const float over_scale = 0.5f * inv_ang_freq;
+            const float over_sin = (u - v) * over_scale;
+            const float over_cos = (u + v) * over_scale;
+            const float critical_sin = u * dts[element];
+            
+            const float sin_theta = damping_squared < 1 ? under_sin
+                : damping_squared > 1 ? over_sin : critical_sin;
+            const float cos_theta = damping_squared < 1 ? under_cos
+                : damping_squared > 1 ? over_cos : u;
+            
+            out_pull_to_target[element] = 1 - spring_flush(
+                ang_freq * cos_theta + damping * sin_theta
+            );
+            out_vel_pos_push[element] = spring_flush(sin_theta / speed);
+            out_vel_push_rate[element] = spring_flush(speed * sin_theta);
+            out_velocity_decay[element] = spring_flush(
+                ang_freq * cos_theta - damping * sin_theta
+            );
+        }
+    }
+}
+
+
+// Lanes are processed in blocks: coefficients first, then one branch free
+// update loop over the block that the compiler can vectorize.
+void spring_lanes_evaluate(
+    SpringLanes* lanes,
+    const size_t count,
+    const double now
+) {
+    float* restrict positions = lanes->position;
+    float* restrict velocities = lanes->velocity;
+    double* restrict times = lanes->time;
+    const float* restrict targets = lanes->target;
+    const float* restrict speeds = lanes->speed;
+    const unsigned char* restrict wraps = lanes->wrap;
+    
+    float dts[LANE_BLOCK_SIZE];
+    float pull_to_target[LANE_BLOCK_SIZE];
+    float vel_pos_push[LANE_BLOCK_SIZE];
+    float vel_push_rate[LANE_BLOCK_SIZE];
+    float velocity_decay[LANE_BLOCK_SIZE];
+    
+    for (size_t start = 0; start < count; start += LANE_BLOCK_SIZE) {
+        const size_t remaining = count - start;
+        const size_t block = remaining < LANE_BLOCK_SIZE
+            ? remaining
+            : LANE_BLOCK_SIZE;
+        
+        for (size_t i = 0; i < block; i++) {
+            dts[i] = speeds[start + i] * (float)(now - times[start + i]);
+        }
+        
+        spring_coefficients_mixed(
+            &(lanes->damping[start]), &(speeds[start]), dts, block,
+            pull_to_target, vel_pos_push, vel_push_rate, velocity_decay
+        );
+        
+        for (size_t i = 0; i < block; i++) {
+            const size_t lane = start + i;
+            const float position = positions[lane];
+            const float velocity = velocities[lane];
+            
+            // wrap(x) = ((x + tau) mod 2tau) - tau, with a floored modulo.
+            const float difference = targets[lane] - position;
+            const float wrapped = difference - (float)(2 * TAU)
+                * floorf((difference + (float)TAU) * (float)(1 / (2 * TAU)));
+            const float offset = spring_flush(
+                wraps && wraps[lane] ? wrapped : difference
+            );
+            
+            const float new_position = position + offset * pull_to_target[i]
+                + velocity * vel_pos_push[i];
+            positions[lane] = spring_flush(targets[lane] - new_position) == 0
+                ? targets[lane]
+                : new_position;
+            velocities[lane] = spring_flush(
+                offset * vel_push_rate[i] + velocity * velocity_decay[i]
+            );
+            times[lane] = now;
+        }
+    }
+}
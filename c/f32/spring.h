@@ -0,0 +1,402 @@
+#ifndef SPRING_H
+#define SPRING_H
+
+#include <math.h>
+#include <stddef.h>
+#include "frame_clock.h"
+
+// Core shared by every spring type. All springs follow the same closed form
+// solution: after a speed scaled elapsed time, the new state is
+//
+//   position = position + difference * pull_to_target + velocity * vel_pos_push
+//   velocity = difference * vel_push_rate + velocity * velocity_decay
+//
+// where `difference` runs from position to target and the four
+// coefficients only depend on damping, speed and elapsed time.
+//
+// SPRING_DECLARE and SPRING_DEFINE generate a spring type and its functions
+// for a value type, see number_spring.h for an example. Before
+// SPRING_DEFINE, the source file defines these for the value type:
+//
+//   Value prefix_difference(const Value* target, const Value* position)
+//   Value prefix_madd(const Value a, const Value b, const float scale)
+//   Value prefix_scale(const Value a, const float scale)
+//   Value prefix_wrap(const Value position)
+//   float prefix_component(const Value* value, const size_t index)
+//   void prefix_set_component(Value* value, const size_t index, float x)
+//
+// `prefix_madd` is a + b * scale, and `prefix_wrap` maps an assigned
+// position into the range the spring works in.
+//
+// Springs are lazily evaluated and memoized on the clock time like
+// QuaternionSpring. Never write to struct fields directly.
+
+
+// A decaying spring would otherwise drift into denormal floats, which are
+// 10-100x slower on x86. Coefficients, differences and velocities below
+// SPRING_FLUSH_EPSILON are flushed to exact zeros, and positions that close
+// to their target snap to it. The product of two unflushed values is still
+// a normal float, so the spring kernels never produce denormals.
+#define SPRING_FLUSH_EPSILON 1e-18f
+
+// Exponentials are clamped at e^SPRING_EXP_FLOOR (about 1e-18), which
+// keeps expf itself out of the denormal range.
+#define SPRING_EXP_FLOOR -41.0f
+
+static inline float spring_flush(
+    const float x
+) {
+    return fabsf(x) < SPRING_FLUSH_EPSILON ? 0.0f : x;
+}
+
+
+// Coefficients for each speed scaled elapsed time in `dts`, sharing one
+// damping and speed. The damping regime is chosen once for the whole array.
+void spring_coefficients(
+    const float damping,
+    const float speed,
+    const float dts[],
+    const size_t count,
+    float out_pull_to_target[],
+    float out_vel_pos_push[],
+    float out_vel_push_rate[],
+    float out_velocity_decay[]
+);
+
+// Same as spring_coefficients, with a damping and speed per element.
+void spring_coefficients_mixed(
+    const float dampings[],
+    const float speeds[],
+    const float dts[],
+    const size_t count,
+    float out_pull_to_target[],
+    float out_vel_pos_push[],
+    float out_vel_push_rate[],
+    float out_velocity_decay[]
+);
+
+
+// Springs split into independent scalar lanes, stored as structure of
+// arrays. A spring of any value type occupies one lane per component, so
+// springs of different types can be evaluated together in one pass.
+// `wrap` may be NULL, otherwise lanes with a non-zero flag are angles and
+// their difference is wrapped into [-tau, tau) like RadianSpring.
+typedef struct SpringLanes {
+    float* position;
+    float* target;
+    float* velocity;
+    float* damping;
+    float* speed;
+    double* time;
+    unsigned char* wrap;
+} SpringLanes;
+
+// Advances `count` lanes to clock time `now`.
+void spring_lanes_evaluate(
+    SpringLanes* lanes,
+    const size_t count,
+    const double now
+);
+
+
+static inline double spring_time_now(
+    double (*clock)(void*),
+    void* clock_state,
+    const FrameClock* frame_clock
+) {
+    return frame_clock ? frame_clock->time : clock(clock_state);
+}
+
+
+#define SPRING_DECLARE(Type, prefix, Value)                                   \
+    typedef struct Type {                                                     \
+        Value position;                                                       \
+        Value target;                                                         \
+        Value _initial;                                                       \
+        Value velocity;                                                       \
+        float damping;                                                        \
+        float speed;                                                          \
+        double (*clock)(void*);                                               \
+        void* clock_state;                                                    \
+        const FrameClock* frame_clock;                                        \
+        double _time;                                                         \
+    } Type;                                                                   \
+                                                                              \
+    void prefix##_new(                                                        \
+        const Value* initial,                                                 \
+        const float damping,                                                  \
+        const float speed,                                                    \
+        double (*clock)(void*),                                               \
+        void* clock_state,                                                    \
+        Type* out_spring                                                      \
+    );                                                                        \
+    void prefix##_new_frame_clock(                                            \
+        const Value* initial,                                                 \
+        const float damping,                                                  \
+        const float speed,                                                    \
+        const FrameClock* frame_clock,                                        \
+        Type* out_spring                                                      \
+    );                                                                        \
+    void prefix##_evaluate(                                                   \
+        Type* self,                                                           \
+        Value* out_position,                                                  \
+        Value* out_velocity                                                   \
+    );                                                                        \
+    void prefix##_set_position(Type* self, const Value* position);            \
+    void prefix##_set_target(Type* self, const Value* target);                \
+    void prefix##_set_velocity(Type* self, const Value* velocity);            \
+    void prefix##_set_damping(Type* self, const float damping);               \
+    void prefix##_set_speed(Type* self, const float speed);                   \
+    void prefix##_set_clock(                                                  \
+        Type* self,                                                           \
+        double (*clock)(void*),                                               \
+        void* clock_state                                                     \
+    );                                                                        \
+    void prefix##_set_frame_clock(Type* self, const FrameClock* frame_clock); \
+    void prefix##_reset(Type* self, const Value* optional_target);            \
+    void prefix##_impulse(Type* self, const Value* impulse);                  \
+    void prefix##_time_skip(Type* self, const double delta);                  \
+    /* Copies the spring into lanes [lane, lane + components). */             \
+    void prefix##_to_lanes(                                                   \
+        const Type* self,                                                     \
+        SpringLanes* lanes,                                                   \
+        const size_t lane                                                     \
+    );                                                                        \
+    void prefix##_from_lanes(                                                 \
+        Type* self,                                                           \
+        const SpringLanes* lanes,                                             \
+        const size_t lane                                                     \
+    );
+
+
+#define SPRING_DEFINE(Type, prefix, Value, components, wrap_lanes)            \
+    /* Flushes tiny components to zero, returns 1 if all of them are. */     \
+    static int prefix##_flush(Value* value) {                                 \
+        int zero = 1;                                                         \
+        for (size_t i = 0; i < (components); i++) {                           \
+            const float x = spring_flush(prefix##_component(value, i));       \
+            prefix##_set_component(value, i, x);                              \
+            zero = zero && x == 0;                                            \
+        }                                                                     \
+        return zero;                                                          \
+    }                                                                         \
+                                                                              \
+    static void prefix##_evaluate_at(                                         \
+        const Type* self,                                                     \
+        const double now,                                                     \
+        Value* out_position,                                                  \
+        Value* out_velocity                                                   \
+    ) {                                                                       \
+        const float dt = self->speed * (float)(now - self->_time);            \
+        float pull_to_target, vel_pos_push, vel_push_rate, velocity_decay;    \
+        spring_coefficients(                                                  \
+            self->damping, self->speed, &dt, 1,                               \
+            &pull_to_target, &vel_pos_push, &vel_push_rate, &velocity_decay   \
+        );                                                                    \
+                                                                              \
+        Value difference = prefix##_difference(                               \
+            &(self->target), &(self->position)                                \
+        );                                                                    \
+        prefix##_flush(&difference);                                          \
+        if (out_position) {                                                   \
+            const Value pulled = prefix##_madd(                               \
+                self->position, difference, pull_to_target                    \
+            );                                                                \
+            const Value position = prefix##_madd(                             \
+                pulled, self->velocity, vel_pos_push                          \
+            );                                                                \
+            Value remaining = prefix##_difference(&(self->target), &position); \
+            *out_position = prefix##_flush(&remaining)                        \
+                ? self->target                                                \
+                : position;                                                   \
+        }                                                                     \
+        if (out_velocity) {                                                   \
+            const Value pushed = prefix##_scale(difference, vel_push_rate);   \
+            Value velocity = prefix##_madd(                                   \
+                pushed, self->velocity, velocity_decay                        \
+            );                                                                \
+            prefix##_flush(&velocity);                                        \
+            *out_velocity = velocity;                                         \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /* State is always at _time, so a spring is only evaluated once per */   \
+    /* clock time however many reads and setters happen in that tick. */     \
+    static void prefix##_advance(                                             \
+        Type* self,                                                           \
+        const double now,                                                     \
+        Value* position,                                                      \
+        Value* velocity                                                       \
+    ) {                                                                       \
+        if (now != self->_time) {                                             \
+            prefix##_evaluate_at(self, now, position, velocity);              \
+        }                                                                     \
+        self->_time = now;                                                    \
+    }                                                                         \
+                                                                              \
+    static double prefix##_now(const Type* self) {                            \
+        return spring_time_now(                                               \
+            self->clock, self->clock_state, self->frame_clock                 \
+        );                                                                    \
+    }                                                                         \
+                                                                              \
+    void prefix##_new(                                                        \
+        const Value* initial,                                                 \
+        const float damping,                                                  \
+        const float speed,                                                    \
+        double (*clock)(void*),                                               \
+        void* clock_state,                                                    \
+        Type* out_spring                                                      \
+    ) {                                                                       \
+        const Value position = prefix##_wrap(*initial);                       \
+        out_spring->position = position;                                      \
+        out_spring->target = position;                                        \
+        out_spring->_initial = position;                                      \
+        out_spring->velocity = prefix##_scale(position, 0.0f);                \
+        out_spring->damping = damping;                                        \
+        out_spring->speed = speed;                                            \
+        out_spring->clock = clock;                                            \
+        out_spring->clock_state = clock_state;                                \
+        out_spring->frame_clock = NULL;                                       \
+        out_spring->_time = clock(clock_state);                               \
+    }                                                                         \
+                                                                              \
+    void prefix##_new_frame_clock(                                            \
+        const Value* initial,                                                 \
+        const float damping,                                                  \
+        const float speed,                                                    \
+        const FrameClock* frame_clock,                                        \
+        Type* out_spring                                                      \
+    ) {                                                                       \
+        prefix##_new(                                                         \
+            initial, damping, speed,                                          \
+            frame_clock_read, (void*)frame_clock, out_spring                  \
+        );                                                                    \
+        out_spring->frame_clock = frame_clock;                                \
+    }                                                                         \
+                                                                              \
+    void prefix##_evaluate(                                                   \
+        Type* self,                                                           \
+        Value* out_position,                                                  \
+        Value* out_velocity                                                   \
+    ) {                                                                       \
+        prefix##_advance(                                                     \
+            self, prefix##_now(self), &(self->position), &(self->velocity)    \
+        );                                                                    \
+        if (out_position) {                                                   \
+            *out_position = self->position;                                   \
+        }                                                                     \
+        if (out_velocity) {                                                   \
+            *out_velocity = self->velocity;                                   \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    void prefix##_set_position(Type* self, const Value* position) {           \
+        prefix##_advance(self, prefix##_now(self), NULL, &(self->velocity));  \
+        self->position = prefix##_wrap(*position);                            \
+    }                                                                         \
+                                                                              \
+    void prefix##_set_target(Type* self, const Value* target) {               \
+        prefix##_advance(                                                     \
+            self, prefix##_now(self), &(self->position), &(self->velocity)    \
+        );                                                                    \
+        self->target = *target;                                               \
+    }                                                                         \
+                                                                              \
+    void prefix##_set_velocity(Type* self, const Value* velocity) {           \
+        prefix##_advance(self, prefix##_now(self), &(self->position), NULL);  \
+        self->velocity = *velocity;                                           \
+    }                                                                         \
+                                                                              \
+    void prefix##_set_damping(Type* self, const float damping) {              \
+        prefix##_advance(                                                     \
+            self, prefix##_now(self), &(self->position), &(self->velocity)    \
+        );                                                                    \
+        self->damping = damping;                                              \
+    }                                                                         \
+                                                                              \
+    void prefix##_set_speed(Type* self, const float speed) {                  \
+        prefix##_advance(                                                     \
+            self, prefix##_now(self), &(self->position), &(self->velocity)    \
+        );                                                                    \
+        self->speed = speed < 0 ? 0.0f : speed;                               \
+    }                                                                         \
+                                                                              \
+    void prefix##_set_clock(                                                  \
+        Type* self,                                                           \
+        double (*clock)(void*),                                               \
+        void* clock_state                                                     \
+    ) {                                                                       \
+        prefix##_advance(                                                     \
+            self, prefix##_now(self), &(self->position), &(self->velocity)    \
+        );                                                                    \
+        self->clock = clock;                                                  \
+        self->clock_state = clock_state;                                      \
+        self->frame_clock = NULL;                                             \
+        self->_time = clock(clock_state);                                     \
+    }                                                                         \
+                                                                              \
+    void prefix##_set_frame_clock(Type* self, const FrameClock* frame_clock) {\
+        prefix##_set_clock(self, frame_clock_read, (void*)frame_clock);       \
+        self->frame_clock = frame_clock;                                      \
+    }                                                                         \
+                                                                              \
+    void prefix##_reset(Type* self, const Value* optional_target) {           \
+        const Value target = optional_target                                  \
+            ? prefix##_wrap(*optional_target)                                 \
+            : self->_initial;                                                 \
+        self->_initial = target;                                              \
+        self->position = target;                                              \
+        self->target = target;                                                \
+        self->velocity = prefix##_scale(target, 0.0f);                        \
+        self->_time = prefix##_now(self);                                     \
+    }                                                                         \
+                                                                              \
+    void prefix##_impulse(Type* self, const Value* impulse) {                 \
+        prefix##_advance(                                                     \
+            self, prefix##_now(self), &(self->position), &(self->velocity)    \
+        );                                                                    \
+        self->velocity = prefix##_madd(self->velocity, *impulse, 1.0f);       \
+    }                                                                         \
+                                                                              \
+    void prefix##_time_skip(Type* self, const double delta) {                 \
+        const double now = prefix##_now(self);                                \
+        prefix##_advance(                                                     \
+            self, now, &(self->position), &(self->velocity)                   \
+        );                                                                    \
+        prefix##_evaluate_at(                                                 \
+            self, now + delta, &(self->position), &(self->velocity)           \
+        );                                                                    \
+    }                                                                         \
+                                                                              \
+    void prefix##_to_lanes(                                                   \
+        const Type* self,                                                     \
+        SpringLanes* lanes,                                                   \
+        const size_t lane                                                     \
+    ) {                                                                       \
+        for (size_t i = 0; i < (components); i++) {                           \
+            lanes->position[lane + i] = prefix##_component(&(self->position), i); \
+            lanes->target[lane + i] = prefix##_component(&(self->target), i); \
+            lanes->velocity[lane + i] = prefix##_component(&(self->velocity), i); \
+            lanes->damping[lane + i] = self->damping;                         \
+            lanes->speed[lane + i] = self->speed;                             \
+            lanes->time[lane + i] = self->_time;                              \
+            if (lanes->wrap) {                                                \
+                lanes->wrap[lane + i] = (wrap_lanes);                         \
+            }                                                                 \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    void prefix##_from_lanes(                                                 \
+        Type* self,                                                           \
+        const SpringLanes* lanes,                                             \
+        const size_t lane                                                     \
+    ) {                                                                       \
+        for (size_t i = 0; i < (components); i++) {                           \
+            prefix##_set_component(&(self->position), i, lanes->position[lane + i]); \
+            prefix##_set_component(&(self->velocity), i, lanes->velocity[lane + i]); \
+        }                                                                     \
+        self->_time = lanes->time[lane];                                      \
+    }
+
+#endif
@@ -0,0 +1,591 @@
+#include "spring_recorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "quaternion.h"
+#include "vector3.h"
+
+
+enum SpringOp {
+    SPRING_OP_SET_TARGET,
+    SPRING_OP_SET_POSITION,
+    SPRING_OP_SET_VELOCITY,
+    SPRING_OP_SET_DAMPING,
+    SPRING_OP_SET_SPEED,
+    SPRING_OP_IMPULSE,
+    SPRING_OP_RESET,
+    SPRING_OP_RESET_INITIAL,
+    SPRING_OP_TIME_SKIP,
+    SPRING_OP_SET_SETTLE_EPSILON,
+    SPRING_OP_EVALUATE,
+};
+
+// Opcode, time header, 8 time bytes, 5 varint bytes and a 16 byte payload.
+#define MAX_RECORD_SIZE 31
+
+
+int spring_recorder_init(
+    SpringRecorder* out_recorder,
+    const size_t initial_capacity
+) {
+    const size_t capacity = initial_capacity > MAX_RECORD_SIZE
+        ? initial_capacity
+        : MAX_RECORD_SIZE;
+    
+    out_recorder->buffer = (unsigned char*) malloc(capacity);
+    out_recorder->size = 0;
+    out_recorder->capacity = out_recorder->buffer ? capacity : 0;
+    out_recorder->_previous_time = 0;
+    
+    return out_recorder->buffer != NULL;
+}
+
+
+void spring_recorder_free(
+    SpringRecorder* self
+) {
+    free(self->buffer);
+    self->buffer = NULL;
+    self->size = 0;
+    self->capacity = 0;
+}
+
+
+// Growing is rare, so it stays out of line from the record functions.
+static int grow(
+    SpringRecorder* self
+) {
+    const size_t capacity = 2 * self->capacity;
+    unsigned char* buffer = (unsigned char*) realloc(self->buffer, capacity);
+    if (!buffer) {
+        return 0;
+    }
+    
+    self->buffer = buffer;
+    self->capacity = capacity;
+    return 1;
+}
+
+
+// Writes the record header and returns where the payload goes, or NULL if
+// the log could not grow. Every record fits in MAX_RECORD_SIZE bytes, so
+// the writes after the single capacity check are unchecked.
+static inline unsigned char* begin_record(
+    SpringRecorder* self,
+    const enum SpringOp op,
+    const uint32_t index,
+    const double time
+) {
+    if (self->capacity - self->size < MAX_RECORD_SIZE && !grow(self)) {
+        return NULL;
+    }
+    
+    unsigned char* out = self->buffer + self->size;
+    *(out++) = (unsigned char)op;
+    
+    uint64_t bits;
+    memcpy(&bits, &time, sizeof(bits));
+    uint64_t delta = bits ^ self->_previous_time;
+    self->_previous_time = bits;
+    
+    // Header: leading zero bytes in the high nibble, stored bytes in the low.
+    unsigned int leading = 8;
+    unsigned int length = 0;
+    if (delta) {
+        #if defined(__GNUC__) || defined(__clang__)
+            const unsigned int trailing = (unsigned int)__builtin_ctzll(delta) / 8;
+            leading = (unsigned int)__builtin_clzll(delta) / 8;
+        #else
+            unsigned int trailing = 0;
+            while (!((delta >> (8 * trailing)) & 0xFF)) {
+                trailing++;
+            }
+            leading = 0;
+            while (!((delta >> (56 - 8 * leading)) & 0xFF)) {
+                leading++;
+            }
+        #endif
+        length = 8 - leading - trailing;
+        delta >>= 8 * trailing;
+    }
+    *(out++) = (unsigned char)(leading << 4 | length);
+    for (unsigned int i = 0; i < length; i++) {
+        *(out++) = (unsigned char)(delta >> (8 * i));
+    }
+    
+    uint32_t varint = index;
+    while (varint >= 0x80) {
+        *(out++) = (unsigned char)(varint | 0x80);
+        varint >>= 7;
+    }
+    *(out++) = (unsigned char)varint;
+    
+    return out;
+}
+
+
+static inline void end_record(
+    SpringRecorder* self,
+    const unsigned char* payload,
+    const size_t payload_size
+) {
+    self->size = (size_t)(payload - self->buffer) + payload_size;
+}
+
+
+static int record_quaternion(
+    SpringRecorder* self,
+    const enum SpringOp op,
+    const uint32_t index,
+    const double time,
+    const Quaternion* value
+) {
+    unsigned char* out = begin_record(self, op, index, time);
+    if (!out) {
+        return 0;
+    }
+    
+    const float floats[4] = {value->x, value->y, value->z, value->w};
+    memcpy(out, floats, sizeof(floats));
+    end_record(self, out, sizeof(floats));
+    return 1;
+}
+
+
+static int record_vector3(
+    SpringRecorder* self,
+    const enum SpringOp op,
+    const uint32_t index,
+    const double time,
+    const Vector3* value
+) {
+    unsigned char* out = begin_record(self, op, index, time);
+    if (!out) {
+        return 0;
+    }
+    
+    const float floats[3] = {value->x, value->y, value->z};
+    memcpy(out, floats, sizeof(floats));
+    end_record(self, out, sizeof(floats));
+    return 1;
+}
+
+
+static int record_float(
+    SpringRecorder* self,
+    const enum SpringOp op,
+    const uint32_t index,
+    const double time,
+    const float value
+) {
+    unsigned char* out = begin_record(self, op, index, time);
+    if (!out) {
+        return 0;
+    }
+    
+    memcpy(out, &value, sizeof(value));
+    end_record(self, out, sizeof(value));
+    return 1;
+}
+
+
+// Pins the spring's clock to the recorded time for the duration of the
+// call, so it sees exactly that time even if its clock has moved on.
+static inline const FrameClock* pin_clock(
+    QuaternionSpring* spring,
+    FrameClock* pinned,
+    const double now
+) {
+    const FrameClock* previous = spring->frame_clock;
+    pinned->time = now;
+    spring->frame_clock = pinned;
+    return previous;
+}
+
+
+int spring_record_set_target(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Quaternion* target
+) {
+    const double now = quaternion_spring_now(spring);
+    if (!record_quaternion(self, SPRING_OP_SET_TARGET, index, now, target)) {
+        return 0;
+    }
+    FrameClock pinned;
+    const FrameClock* previous = pin_clock(spring, &pinned, now);
+    quaternion_spring_set_target(spring, target);
+    spring->frame_clock = previous;
+    return 1;
+}
+
+
+int spring_record_set_position(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Quaternion* position
+) {
+    const double now = quaternion_spring_now(spring);
+    if (!record_quaternion(self, SPRING_OP_SET_POSITION, index, now, position)) {
+        return 0;
+    }
+    FrameClock pinned;
+    const FrameClock* previous = pin_clock(spring, &pinned, now);
+    quaternion_spring_set_position(spring, position);
+    spring->frame_clock = previous;
+    return 1;
+}
+
+
+int spring_record_set_velocity(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Vector3* velocity
+) {
+    const double now = quaternion_spring_now(spring);
+    if (!record_vector3(self, SPRING_OP_SET_VELOCITY, index, now, velocity)) {
+        return 0;
+    }
+    FrameClock pinned;
+    const FrameClock* previous = pin_clock(spring, &pinned, now);
+    quaternion_spring_set_velocity(spring, velocity);
+    spring->frame_clock = previous;
+    return 1;
+}
+
+
+int spring_record_set_damping(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const float damping
+) {
+    const double now = quaternion_spring_now(spring);
+    if (!record_float(self, SPRING_OP_SET_DAMPING, index, now, damping)) {
+        return 0;
+    }
+    FrameClock pinned;
+    const FrameClock* previous = pin_clock(spring, &pinned, now);
+    quaternion_spring_set_damping(spring, damping);
+    spring->frame_clock = previous;
+    return 1;
+}
+
+
+int spring_record_set_speed(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const float speed
+) {
+    const double now = quaternion_spring_now(spring);
+    if (!record_float(self, SPRING_OP_SET_SPEED, index, now, speed)) {
+        return 0;
+    }
+    FrameClock pinned;
+    const FrameClock* previous = pin_clock(spring, &pinned, now);
+    quaternion_spring_set_speed(spring, speed);
+    spring->frame_clock = previous;
+    return 1;
+}
+
+
+int spring_record_impulse(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Vector3* impulse
+) {
+    const double now = quaternion_spring_now(spring);
+    if (!record_vector3(self, SPRING_OP_IMPULSE, index, now, impulse)) {
+        return 0;
+    }
+    FrameClock pinned;
+    const FrameClock* previous = pin_clock(spring, &pinned, now);
+    quaternion_spring_impulse(spring, impulse);
+    spring->frame_clock = previous;
+    return 1;
+}
+
+
+int spring_record_reset(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Quaternion* optional_target
+) {
+    const double now = quaternion_spring_now(spring);
+    if (optional_target) {
+        if (!record_quaternion(self, SPRING_OP_RESET, index, now, optional_target)) {
+            return 0;
+        }
+    } else {
+        unsigned char* out = begin_record(self, SPRING_OP_RESET_INITIAL, index, now);
+        if (!out) {
+            return 0;
+        }
+        end_record(self, out, 0);
+    }
+    FrameClock pinned;
+    const FrameClock* previous = pin_clock(spring, &pinned, now);
+    quaternion_spring_reset(spring, optional_target);
+    spring->frame_clock = previous;
+    return 1;
+}
+
+
+int spring_record_set_settle_epsilon(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const float epsilon
+) {
+    const double now = quaternion_spring_now(spring);
+    if (!record_float(self, SPRING_OP_SET_SETTLE_EPSILON, index, now, epsilon)) {
+        return 0;
+    }
+    quaternion_spring_set_settle_epsilon(spring, epsilon);
+    return 1;
+}
+
+
+int spring_record_evaluate(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    Quaternion* out_position,
+    Vector3* out_velocity
+) {
+    const double now = quaternion_spring_now(spring);
+    
+    // Memoized, so the evaluation leaves the state as it is. Sleeping
+    // springs are logged too, since evaluating still moves `_time`, which
+    // their settle time reads.
+    if (now != spring->_time) {
+        unsigned char* out = begin_record(self, SPRING_OP_EVALUATE, index, now);
+        if (!out) {
+            return 0;
+        }
+        end_record(self, out, 0);
+    }
+    FrameClock pinned;
+    const FrameClock* previous = pin_clock(spring, &pinned, now);
+    quaternion_spring_evaluate(spring, out_position, out_velocity);
+    spring->frame_clock = previous;
+    return 1;
+}
+
+
+int spring_record_time_skip(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const double delta
+) {
+    const double now = quaternion_spring_now(spring);
+    unsigned char* out = begin_record(self, SPRING_OP_TIME_SKIP, index, now);
+    if (!out) {
+        return 0;
+    }
+    memcpy(out, &delta, sizeof(delta));
+    end_record(self, out, sizeof(delta));
+    FrameClock pinned;
+    const FrameClock* previous = pin_clock(spring, &pinned, now);
+    quaternion_spring_time_skip(spring, delta);
+    spring->frame_clock = previous;
+    return 1;
+}
+
+
+void spring_replayer_init(
+    SpringReplayer* out_replayer,
+    const unsigned char* log,
+    const size_t size,
+    const double start_time
+) {
+    out_replayer->time = start_time;
+    out_replayer->_cursor = log;
+    out_replayer->_end = log + size;
+    out_replayer->_previous_time = 0;
+}
+
+
+double spring_replayer_clock(
+    void* replayer
+) {
+    return ((const SpringReplayer*)replayer)->time;
+}
+
+
+// Reads `size` payload bytes, or returns NULL if the log ends first.
+static const unsigned char* read_bytes(
+    SpringReplayer* self,
+    const size_t size
+) {
+    const unsigned char* bytes = self->_cursor;
+    if ((size_t)(self->_end - bytes) < size) {
+        return NULL;
+    }
+    self->_cursor = bytes + size;
+    return bytes;
+}
+
+
+static Quaternion read_quaternion(
+    const unsigned char* bytes
+) {
+    float floats[4];
+    memcpy(floats, bytes, sizeof(floats));
+    return quaternion_new(floats[0], floats[1], floats[2], floats[3]);
+}
+
+
+static Vector3 read_vector3(
+    const unsigned char* bytes
+) {
+    float floats[3];
+    memcpy(floats, bytes, sizeof(floats));
+    return vector3_new(floats[0], floats[1], floats[2]);
+}
+
+
+int spring_replayer_step(
+    SpringReplayer* self,
+    QuaternionSpring* springs[],
+    const size_t count
+) {
+    if (self->_cursor == self->_end) {
+        return 0;
+    }
+    
+    const unsigned char* header = read_bytes(self, 2);
+    if (!header) {
+        return -1;
+    }
+    const unsigned int op = header[0];
+    const unsigned int leading = header[1] >> 4;
+    const unsigned int length = header[1] & 0x0F;
+    if (leading + length > 8) {
+        return -1;
+    }
+    
+    const unsigned char* time_bytes = read_bytes(self, length);
+    if (!time_bytes) {
+        return -1;
+    }
+    uint64_t delta = 0;
+    for (unsigned int i = 0; i < length; i++) {
+        delta |= (uint64_t)time_bytes[i] << (8 * i);
+    }
+    delta <<= 8 * (8 - leading - length);
+    self->_previous_time ^= delta;
+    memcpy(&(self->time), &(self->_previous_time), sizeof(self->time));
+    
+    uint32_t index = 0;
+    for (unsigned int shift = 0;; shift += 7) {
+        const unsigned char* byte = read_bytes(self, 1);
+        if (!byte || shift > 28) {
+            return -1;
+        }
+        index |= (uint32_t)(*byte & 0x7F) << shift;
+        if (!(*byte & 0x80)) {
+            break;
+        }
+    }
+    if (index >= count) {
+        return -1;
+    }
+    QuaternionSpring* spring = springs[index];
+    
+    const unsigned char* payload;
+    switch (op) {
+        case SPRING_OP_SET_TARGET:
+        case SPRING_OP_SET_POSITION:
+        case SPRING_OP_RESET: {
+            payload = read_bytes(self, 4 * sizeof(float));
+            if (!payload) {
+                return -1;
+            }
+            const Quaternion value = read_quaternion(payload);
+            if (op == SPRING_OP_SET_TARGET) {
+                quaternion_spring_set_target(spring, &value);
+            } else if (op == SPRING_OP_SET_POSITION) {
+                quaternion_spring_set_position(spring, &value);
+            } else {
+                quaternion_spring_reset(spring, &value);
+            }
+            break;
+        }
+        case SPRING_OP_SET_VELOCITY:
+        case SPRING_OP_IMPULSE: {
+            payload = read_bytes(self, 3 * sizeof(float));
+            if (!payload) {
+                return -1;
+            }
+            const Vector3 value = read_vector3(payload);
+            if (op == SPRING_OP_SET_VELOCITY) {
+                quaternion_spring_set_velocity(spring, &value);
+            } else {
+                quaternion_spring_impulse(spring, &value);
+            }
+            break;
+        }
+        case SPRING_OP_SET_DAMPING:
+        case SPRING_OP_SET_SPEED:
+        case SPRING_OP_SET_SETTLE_EPSILON: {
+            payload = read_bytes(self, sizeof(float));
+            if (!payload) {
+                return -1;
+            }
+            float value;
+            memcpy(&value, payload, sizeof(value));
+            if (op == SPRING_OP_SET_DAMPING) {
+                quaternion_spring_set_damping(spring, value);
+            } else if (op == SPRING_OP_SET_SPEED) {
+                quaternion_spring_set_speed(spring, value);
+            } else {
+                quaternion_spring_set_settle_epsilon(spring, value);
+            }
+            break;
+        }
+        case SPRING_OP_RESET_INITIAL:
+            quaternion_spring_reset(spring, NULL);
+            break;
+        case SPRING_OP_EVALUATE:
+            quaternion_spring_evaluate(spring, NULL, NULL);
+            break;
+        case SPRING_OP_TIME_SKIP: {
+            payload = read_bytes(self, sizeof(double));
+            if (!payload) {
+                return -1;
+            }
+            double delta_time;
+            memcpy(&delta_time, payload, sizeof(delta_time));
+            quaternion_spring_time_skip(spring, delta_time);
+            break;
+        }
+        default:
+            return -1;
+    }
+    
+    return 1;
+}
+
+
+long spring_replayer_run(
+    SpringReplayer* self,
+    QuaternionSpring* springs[],
+    const size_t count
+) {
+    long applied = 0;
+    int result;
+    while ((result = spring_replayer_step(self, springs, count)) > 0) {
+        applied++;
+    }
+    
+    return result < 0 ? -1 : applied;
+}
@@ -0,0 +1,159 @@
+#ifndef SPRING_RECORDER_H
+#define SPRING_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "quaternion_spring.h"
+
+// Binary input log of a collection of QuaternionSprings, for replaying
+// them exactly. Each spring_record_ function applies the input to the
+// spring and appends it to the log with the clock time it saw.
+//
+// Evaluating a spring re-bases its state on the time of evaluation, and
+// may put it to sleep, so evaluations are inputs too: recorded springs
+// must be evaluated through spring_record_evaluate, not directly or by a
+// group or pool, for the replay to match bit for bit. Evaluations within
+// the same tick change nothing and are not logged.
+//
+// A record is an opcode byte, the timestamp, the spring's index in the
+// collection as a LEB128 varint, and the raw float payload in native byte
+// order. Timestamps are stored exactly as the XOR of their bits with the
+// previous timestamp, keeping only the non-zero bytes, so inputs within the
+// same tick cost one byte of time and successive frames a few bytes.
+//
+// Never write to struct fields directly.
+// It's ok to read `buffer` and `size`.
+
+typedef struct SpringRecorder {
+    unsigned char* buffer;
+    size_t size;
+    size_t capacity;
+    uint64_t _previous_time;
+} SpringRecorder;
+
+// Drives springs from a log. Springs replayed into must be created with
+// spring_replayer_clock and the replayer as clock state, in the same state
+// the recorded springs started in.
+typedef struct SpringReplayer {
+    double time;
+    const unsigned char* _cursor;
+    const unsigned char* _end;
+    uint64_t _previous_time;
+} SpringReplayer;
+
+
+// Returns 0 if the allocation failed.
+int spring_recorder_init(
+    SpringRecorder* out_recorder,
+    const size_t initial_capacity
+);
+
+void spring_recorder_free(
+    SpringRecorder* self
+);
+
+// Each returns 0, without applying the input, if the log could not grow.
+
+int spring_record_set_target(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Quaternion* target
+);
+
+int spring_record_set_position(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Quaternion* position
+);
+
+int spring_record_set_velocity(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Vector3* velocity
+);
+
+int spring_record_set_damping(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const float damping
+);
+
+int spring_record_set_speed(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const float speed
+);
+
+int spring_record_impulse(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Vector3* impulse
+);
+
+int spring_record_reset(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const Quaternion* optional_target
+);
+
+int spring_record_set_settle_epsilon(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const float epsilon
+);
+
+// quaternion_spring_evaluate, logged.
+int spring_record_evaluate(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    Quaternion* out_position,
+    Vector3* out_velocity
+);
+
+int spring_record_time_skip(
+    SpringRecorder* self,
+    const uint32_t index,
+    QuaternionSpring* spring,
+    const double delta
+);
+
+
+void spring_replayer_init(
+    SpringReplayer* out_replayer,
+    const unsigned char* log,
+    const size_t size,
+    const double start_time
+);
+
+// Clock callback returning the replayer's current time.
+double spring_replayer_clock(
+    void* replayer
+);
+
+// Applies the next record. Returns 1 if a record was applied, 0 at the end
+// of the log, and -1 if the log is malformed or names an index outside
+// `springs[0, count)`.
+int spring_replayer_step(
+    SpringReplayer* self,
+    QuaternionSpring* springs[],
+    const size_t count
+);
+
+// Applies every remaining record. Returns how many were applied, or -1 as
+// spring_replayer_step.
+long spring_replayer_run(
+    SpringReplayer* self,
+    QuaternionSpring* springs[],
+    const size_t count
+);
+
+#endif
@@ -0,0 +1,229 @@
+#include "spring_timer_wheel.h"
+
+#include <math.h>
+#include <stddef.h>
+
+
+#define SLOT_MASK ((uint64_t)SPRING_TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_SPAN(level) ((uint64_t)1 << (SPRING_TIMER_WHEEL_BITS * (level)))
+
+
+void spring_timer_wheel_init(
+    SpringTimerWheel* out_wheel,
+    const double start_time,
+    const double tick_length
+) {
+    for (int level = 0; level < SPRING_TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < SPRING_TIMER_WHEEL_SLOTS; slot++) {
+            out_wheel->_slots[level][slot] = NULL;
+        }
+    }
+    out_wheel->_start_time = start_time;
+    out_wheel->_tick_length = tick_length;
+    out_wheel->_current_tick = 0;
+}
+
+
+void spring_timer_init(
+    SpringTimer* out_timer
+) {
+    out_timer->spring = NULL;
+    out_timer->callback = NULL;
+    out_timer->user_data = NULL;
+    out_timer->epsilon = 0.0f;
+    out_timer->_expiry_tick = 0;
+    out_timer->_next = NULL;
+    out_timer->_pprev = NULL;
+}
+
+
+// Converting a double past the range of uint64_t is undefined, and a
+// finite settle time can still be that many ticks away.
+static uint64_t clamp_tick(
+    const double ticks
+) {
+    if (!(ticks > 0)) {
+        return 0;
+    }
+    return ticks < 0x1p64 ? (uint64_t)ticks : UINT64_MAX;
+}
+
+
+// First tick at or after clock time `time`.
+static uint64_t time_to_tick(
+    const SpringTimerWheel* self,
+    const double time
+) {
+    return clamp_tick(ceil((time - self->_start_time) / self->_tick_length));
+}
+
+
+static void link_timer(
+    SpringTimer** slot,
+    SpringTimer* timer
+) {
+    timer->_next = *slot;
+    timer->_pprev = slot;
+    if (*slot) {
+        (*slot)->_pprev = &(timer->_next);
+    }
+    *slot = timer;
+}
+
+
+// Timers due by the current tick go in its level 0 slot, which is only
+// reached while cascading, before that slot is drained.
+static void wheel_insert(
+    SpringTimerWheel* self,
+    SpringTimer* timer
+) {
+    const uint64_t current = self->_current_tick;
+    if (timer->_expiry_tick <= current) {
+        link_timer(&(self->_slots[0][current & SLOT_MASK]), timer);
+        return;
+    }
+    
+    const uint64_t delta = timer->_expiry_tick - current;
+    
+    int level = 0;
+    while (level < SPRING_TIMER_WHEEL_LEVELS - 1 && delta >= LEVEL_SPAN(level + 1)) {
+        level++;
+    }
+    
+    // Past the range of the wheel, park in the furthest reachable slot.
+    const uint64_t slot_tick = delta < LEVEL_SPAN(SPRING_TIMER_WHEEL_LEVELS)
+        ? timer->_expiry_tick
+        : current + LEVEL_SPAN(SPRING_TIMER_WHEEL_LEVELS) - 1;
+    
+    const uint64_t slot = (slot_tick >> (SPRING_TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+    link_timer(&(self->_slots[level][slot]), timer);
+}
+
+
+void spring_timer_cancel(
+    SpringTimer* timer
+) {
+    if (!timer->_pprev) {
+        return;
+    }
+    
+    *(timer->_pprev) = timer->_next;
+    if (timer->_next) {
+        timer->_next->_pprev = timer->_pprev;
+    }
+    timer->_next = NULL;
+    timer->_pprev = NULL;
+}
+
+
+int spring_timer_is_scheduled(
+    const SpringTimer* timer
+) {
+    return timer->_pprev != NULL;
+}
+
+
+int spring_timer_schedule(
+    SpringTimerWheel* self,
+    SpringTimer* timer,
+    QuaternionSpring* spring,
+    const float epsilon,
+    SpringTimerCallback callback,
+    void* user_data
+) {
+    spring_timer_cancel(timer);
+    
+    const double settle_time = quaternion_spring_settle_time(spring, epsilon);
+    if (settle_time == HUGE_VAL) {
+        return 0;
+    }
+    
+    timer->spring = spring;
+    timer->callback = callback;
+    timer->user_data = user_data;
+    timer->epsilon = epsilon;
+    // The current tick has already been drained.
+    const uint64_t expiry_tick = time_to_tick(self, settle_time);
+    timer->_expiry_tick = expiry_tick > self->_current_tick
+        ? expiry_tick
+        : self->_current_tick + 1;
+    wheel_insert(self, timer);
+    
+    return 1;
+}
+
+
+// Unlinks and returns the first timer of a slot. Popping one at a time
+// keeps the list valid if a callback cancels or schedules other timers.
+static SpringTimer* pop_slot(
+    SpringTimer** slot
+) {
+    SpringTimer* head = *slot;
+    if (head) {
+        spring_timer_cancel(head);
+    }
+    return head;
+}
+
+
+static void fire_timer(
+    SpringTimerWheel* self,
+    SpringTimer* timer
+) {
+    // Parked timers and springs that were disturbed since scheduling.
+    const double settle_time = quaternion_spring_settle_time(
+        timer->spring, timer->epsilon
+    );
+    if (settle_time == HUGE_VAL) {
+        return;
+    }
+    
+    const uint64_t settle_tick = time_to_tick(self, settle_time);
+    if (timer->_expiry_tick > self->_current_tick
+        || settle_tick > self->_current_tick) {
+        if (settle_tick > timer->_expiry_tick) {
+            timer->_expiry_tick = settle_tick;
+        }
+        wheel_insert(self, timer);
+        return;
+    }
+    
+    quaternion_spring_sleep(timer->spring);
+    if (timer->callback) {
+        timer->callback(timer->spring, timer->user_data);
+    }
+}
+
+
+void spring_timer_wheel_advance(
+    SpringTimerWheel* self,
+    const double now
+) {
+    const uint64_t target_tick = clamp_tick(
+        floor((now - self->_start_time) / self->_tick_length)
+    );
+    
+    while (self->_current_tick < target_tick) {
+        const uint64_t current = ++(self->_current_tick);
+        
+        // Cascade higher levels first, so timers they move into a lower
+        // level slot that is also due this tick are cascaded again, and
+        // timers due this tick reach the level 0 slot drained below.
+        for (int level = SPRING_TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            if (current & (LEVEL_SPAN(level) - 1)) {
+                continue;
+            }
+            
+            const uint64_t slot = (current >> (SPRING_TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+            SpringTimer* timer;
+            while ((timer = pop_slot(&(self->_slots[level][slot])))) {
+                wheel_insert(self, timer);
+            }
+        }
+        
+        SpringTimer* timer;
+        while ((timer = pop_slot(&(self->_slots[0][current & SLOT_MASK])))) {
+            fire_timer(self, timer);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef SPRING_TIMER_WHEEL_H
+#define SPRING_TIMER_WHEEL_H
+
+#include <stdint.h>
+#include "quaternion_spring.h"
+
+// Hierarchical timer wheel that puts springs to sleep at their predicted
+// settle time (quaternion_spring_settle_time) and fires a callback, so
+// springs that only need to report "done" are never polled.
+//
+// Each level has SPRING_TIMER_WHEEL_SLOTS slots, and every slot of a level
+// covers a whole revolution of the level below it. Timers further out than
+// the top level are parked in its last slot and re-inserted when reached.
+//
+// Never write to struct fields directly.
+
+#define SPRING_TIMER_WHEEL_BITS 6
+#define SPRING_TIMER_WHEEL_SLOTS (1 << SPRING_TIMER_WHEEL_BITS)
+#define SPRING_TIMER_WHEEL_LEVELS 4
+
+typedef void (*SpringTimerCallback)(QuaternionSpring* spring, void* user_data);
+
+// Caller owned, must stay valid while scheduled. Must be initialized with
+// spring_timer_init, or zero initialized, before it is first scheduled or
+// cancelled, since both unlink it from wherever it was scheduled.
+typedef struct SpringTimer {
+    QuaternionSpring* spring;
+    SpringTimerCallback callback;
+    void* user_data;
+    float epsilon;
+    uint64_t _expiry_tick;
+    struct SpringTimer* _next;
+    struct SpringTimer** _pprev;
+} SpringTimer;
+
+typedef struct SpringTimerWheel {
+    SpringTimer* _slots[SPRING_TIMER_WHEEL_LEVELS][SPRING_TIMER_WHEEL_SLOTS];
+    double _start_time;
+    double _tick_length;
+    uint64_t _current_tick;
+} SpringTimerWheel;
+
+
+void spring_timer_wheel_init(
+    SpringTimerWheel* out_wheel,
+    const double start_time,
+    const double tick_length
+);
+
+void spring_timer_init(
+    SpringTimer* out_timer
+);
+
+// Schedules the spring to be put to sleep once it is within `epsilon` of
+// its target. Reschedule after changing the spring's target, velocity or
+// parameters. Returns 0 if the spring never settles or epsilon is not
+// positive, without scheduling.
+int spring_timer_schedule(
+    SpringTimerWheel* self,
+    SpringTimer* timer,
+    QuaternionSpring* spring,
+    const float epsilon,
+    SpringTimerCallback callback,
+    void* user_data
+);
+
+void spring_timer_cancel(
+    SpringTimer* timer
+);
+
+int spring_timer_is_scheduled(
+    const SpringTimer* timer
+);
+
+// Fires every timer due up to and including clock time `now`. Each due
+// spring is re-checked against its current state: if it was disturbed it is
+// rescheduled, otherwise it is put to sleep and its callback is called.
+void spring_timer_wheel_advance(
+    SpringTimerWheel* self,
+    const double now
+);
+
+#endif
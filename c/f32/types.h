@@ -18,6 +18,15 @@ typedef struct EulerAngles {
     float x, y, z;
 } EulerAngles;
 
+typedef struct ALIGN(8) Vector2 {
+    float x, y;
+} Vector2;
+
+static const Vector2 VECTOR2_ZERO   = {0.0f, 0.0f};
+static const Vector2 VECTOR2_ONE    = {1.0f, 1.0f};
+static const Vector2 VECTOR2_X_AXIS = {1.0f, 0.0f};
+static const Vector2 VECTOR2_Y_AXIS = {0.0f, 1.0f};
+
 typedef struct ALIGN(16) Vector3 {
     float x, y, z;
 } Vector3;
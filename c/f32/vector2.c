@@ -0,0 +1,85 @@
+#include "vector2.h"
+
+#include <math.h>
+
+
+float vector2_magnitude(
+    const Vector2* vector
+) {
+    const float vx = vector->x;
+    const float vy = vector->y;
+    
+    return sqrtf(vx * vx + vy * vy);
+}
+
+
+Vector2 vector2_unit(
+    const Vector2* vector
+) {
+    return vector2_div(vector, vector2_magnitude(vector));
+}
+
+Vector2 vector2_unit_default(
+    const Vector2* vector,
+    const float epsilon,
+    const Vector2* default_vector
+) {
+    float magnitude = vector2_magnitude(vector);
+    if (magnitude >= epsilon) {
+        return vector2_div(vector, magnitude);
+    }
+    
+    return *default_vector;
+}
+
+
+Vector2 vector2_add(
+    const Vector2* v0,
+    const Vector2* v1
+) {
+    Vector2 out = {
+        .x = v0->x + v1->x,
+        .y = v0->y + v1->y
+    };
+    
+    return out;
+}
+
+
+Vector2 vector2_sub(
+    const Vector2* v0,
+    const Vector2* v1
+) {
+    Vector2 out = {
+        .x = v0->x - v1->x,
+        .y = v0->y - v1->y
+    };
+    
+    return out;
+}
+
+
+Vector2 vector2_scale(
+    const Vector2* vector,
+    float scalar
+) {
+    Vector2 out = {
+        .x = vector->x * scalar,
+        .y = vector->y * scalar
+    };
+    
+    return out;
+}
+
+
+Vector2 vector2_div(
+    const Vector2* vector,
+    float scalar
+) {
+    Vector2 out = {
+        .x = vector->x / scalar,
+        .y = vector->y / scalar
+    };
+    
+    return out;
+}
@@ -0,0 +1,49 @@
+#ifndef VECTOR2_H
+#define VECTOR2_H
+
+#include "types.h"
+
+static inline Vector2 vector2_new(
+    const float x, 
+    const float y
+) {
+    return (Vector2) {x, y};
+}
+
+float vector2_magnitude(
+    const Vector2* vector
+);
+
+Vector2 vector2_unit(
+    const Vector2* vector
+);
+
+Vector2 vector2_unit_default(
+    const Vector2* vector,
+    const float epsilon,
+    const Vector2* default_vector
+);
+
+
+Vector2 vector2_add(
+    const Vector2* v0,
+    const Vector2* v1
+);
+
+Vector2 vector2_sub(
+    const Vector2* v0,
+    const Vector2* v1
+);
+
+Vector2 vector2_scale(
+    const Vector2* vector,
+    const float scalar
+);
+
+Vector2 vector2_div(
+    const Vector2* vector,
+    const float scalar
+);
+
+
+#endif
@@ -0,0 +1,57 @@
+#include "vector2_spring.h"
+
+#include "vector2.h"
+
+
+static inline Vector2 vector2_spring_difference(
+    const Vector2* target,
+    const Vector2* position
+) {
+    return vector2_sub(target, position);
+}
+
+static inline Vector2 vector2_spring_madd(
+    const Vector2 a,
+    const Vector2 b,
+    const float scale
+) {
+    return vector2_new(
+        a.x + b.x * scale,
+        a.y + b.y * scale
+    );
+}
+
+static inline Vector2 vector2_spring_scale(
+    const Vector2 a,
+    const float scale
+) {
+    return vector2_new(a.x * scale, a.y * scale);
+}
+
+static inline Vector2 vector2_spring_wrap(
+    const Vector2 position
+) {
+    return position;
+}
+
+static inline float vector2_spring_component(
+    const Vector2* value,
+    const size_t index
+) {
+    return index == 0 ? value->x : value->y;
+}
+
+static inline void vector2_spring_set_component(
+    Vector2* value,
+    const size_t index,
+    const float x
+) {
+    if (index == 0) {
+        value->x = x;
+    } else {
+        value->y = x;
+    }
+}
+
+
+SPRING_DEFINE(Vector2Spring, vector2_spring, Vector2, VECTOR2_SPRING_LANES, 0)
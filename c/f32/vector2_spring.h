@@ -0,0 +1,13 @@
+#ifndef VECTOR2_SPRING_H
+#define VECTOR2_SPRING_H
+
+#include "types.h"
+#include "spring.h"
+
+// Spring for a Vector2, see spring.h for the generated functions.
+
+#define VECTOR2_SPRING_LANES 2
+
+SPRING_DECLARE(Vector2Spring, vector2_spring, Vector2)
+
+#endif
@@ -34,7 +34,35 @@ Vector3 vector3_unit_default(
 }
 
 
-Vector3 vector3_mul(
+Vector3 vector3_add(
+    const Vector3* v0,
+    const Vector3* v1
+) {
+    Vector3 out = {
+        .x = v0->x + v1->x,
+        .y = v0->y + v1->y,
+        .z = v0->z + v1->z
+    };
+    
+    return out;
+}
+
+
+Vector3 vector3_sub(
+    const Vector3* v0,
+    const Vector3* v1
+) {
+    Vector3 out = {
+        .x = v0->x - v1->x,
+        .y = v0->y - v1->y,
+        .z = v0->z - v1->z
+    };
+    
+    return out;
+}
+
+
+Vector3 vector3_scale(
     const Vector3* vector,
     float scalar
 ) {
@@ -31,6 +31,11 @@ Vector3 vector3_add(
     const Vector3* v1
 );
 
+Vector3 vector3_sub(
+    const Vector3* v0,
+    const Vector3* v1
+);
+
 Vector3 vector3_scale(
     const Vector3* vector,
     const float scalar
@@ -0,0 +1,60 @@
+#include "vector3_spring.h"
+
+#include "vector3.h"
+
+
+static inline Vector3 vector3_spring_difference(
+    const Vector3* target,
+    const Vector3* position
+) {
+    return vector3_sub(target, position);
+}
+
+static inline Vector3 vector3_spring_madd(
+    const Vector3 a,
+    const Vector3 b,
+    const float scale
+) {
+    return vector3_new(
+        a.x + b.x * scale,
+        a.y + b.y * scale,
+        a.z + b.z * scale
+    );
+}
+
+static inline Vector3 vector3_spring_scale(
+    const Vector3 a,
+    const float scale
+) {
+    return vector3_new(a.x * scale, a.y * scale, a.z * scale);
+}
+
+static inline Vector3 vector3_spring_wrap(
+    const Vector3 position
+) {
+    return position;
+}
+
+static inline float vector3_spring_component(
+    const Vector3* value,
+    const size_t index
+) {
+    return index == 0 ? value->x : index == 1 ? value->y : value->z;
+}
+
+static inline void vector3_spring_set_component(
+    Vector3* value,
+    const size_t index,
+    const float x
+) {
+    if (index == 0) {
+        value->x = x;
+    } else if (index == 1) {
+        value->y = x;
+    } else {
+        value->z = x;
+    }
+}
+
+
+SPRING_DEFINE(Vector3Spring, vector3_spring, Vector3, VECTOR3_SPRING_LANES, 0)
@@ -0,0 +1,13 @@
+#ifndef VECTOR3_SPRING_H
+#define VECTOR3_SPRING_H
+
+#include "types.h"
+#include "spring.h"
+
+// Spring for a Vector3, see spring.h for the generated functions.
+
+#define VECTOR3_SPRING_LANES 3
+
+SPRING_DECLARE(Vector3Spring, vector3_spring, Vector3)
+
+#endif
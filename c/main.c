@@ -1,8 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <time.h>
 
+#include "f32/float_env.h"
 #include "f32/quaternion.h"
+#include "f32/quaternion_spring.h"
+#include "f32/spring.h"
+#include "f32/spring_timer_wheel.h"
 #include "f32/vector3.h"
 
 
@@ -49,6 +54,246 @@ void run_test_cases() {
 }
 /**/
 
+// Turn into "//*" to remove comment
+/*
+static double benchmark_time = 0.0;
+
+static double benchmark_clock(void* state) {
+    return benchmark_time;
+}
+
+// Nanoseconds per spring evaluation, and per sample of quaternion_spring_sample.
+// The build flags change these severalfold: fusing the position and velocity
+// updates took evaluate from about 540 to 220 ns and sample from 275 to 170
+// ns with the Makefile's flags, which do not optimize, and from 208 to 115
+// ns and 61 to 48 ns with -O2.
+void run_spring_benchmark() {
+    const size_t samples = 4096;
+    const int rounds = 2000;
+    
+    const Vector3 axis = vector3_new(0.3f, 0.9f, 0.2f);
+    const Vector3 unit_axis = vector3_unit(&axis);
+    const Quaternion target = quaternion_from_axis_angle(&unit_axis, 2.0f);
+    const Vector3 impulse = vector3_new(1.0f, -2.0f, 0.5f);
+    
+    QuaternionSpring spring;
+    quaternion_spring_new(
+        &QUATERNION_IDENTITY, 0.4f, 5.0f, benchmark_clock, NULL, &spring
+    );
+    
+    float checksum = 0.0f;
+    clock_t start = clock();
+    for (int round = 0; round < rounds; round++) {
+        quaternion_spring_set_target(&spring, &target);
+        quaternion_spring_impulse(&spring, &impulse);
+        for (size_t i = 0; i < samples; i++) {
+            benchmark_time += 1e-4;
+            quaternion_spring_evaluate(&spring, NULL, NULL);
+            checksum += spring.position.w;
+        }
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("evaluate: %.1f ns\n", seconds * 1e9 / ((double)rounds * samples));
+    
+    double* times = malloc(samples * sizeof(double));
+    Quaternion* positions = malloc(samples * sizeof(Quaternion));
+    Vector3* velocities = malloc(samples * sizeof(Vector3));
+    for (size_t i = 0; i < samples; i++) {
+        times[i] = benchmark_time + i * 1e-3;
+    }
+    
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        quaternion_spring_sample(&spring, times, samples, positions, velocities);
+        checksum += positions[round % samples].w;
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("sample: %.1f ns (%f)\n", seconds * 1e9 / ((double)rounds * samples), checksum);
+    
+    free(times);
+    free(positions);
+    free(velocities);
+}
+/**/
+
+// Turn into "//*" to remove comment
+/*
+// A decay loop on denormal inputs, with and without FTZ/DAZ.
+static double denormal_kernel(float* values, const size_t count, const int rounds) {
+    clock_t start = clock();
+    for (int round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < count; i++) {
+            values[i] = values[i] * 0.5f + 1e-40f;
+        }
+    }
+    return (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / ((double)rounds * count);
+}
+
+// Nanoseconds per lane while idle springs decay past where their velocity
+// would become denormal, which is around frame 1000 without flushing.
+void run_denormal_benchmark() {
+    const size_t count = 4096;
+    float* values = malloc(count * sizeof(float));
+    
+    for (size_t i = 0; i < count; i++) {
+        values[i] = 1e-39f;
+    }
+    printf("denormal kernel: %.2f ns\n", denormal_kernel(values, count, 1000));
+    
+    FloatEnvironment saved;
+    float_env_flush_denormals(&saved);
+    for (size_t i = 0; i < count; i++) {
+        values[i] = 1e-39f;
+    }
+    printf("denormal kernel, FTZ/DAZ: %.2f ns\n", denormal_kernel(values, count, 1000));
+    float_env_restore(&saved);
+    free(values);
+    
+    float* position = malloc(count * sizeof(float));
+    float* target = malloc(count * sizeof(float));
+    float* velocity = malloc(count * sizeof(float));
+    float* damping = malloc(count * sizeof(float));
+    float* speed = malloc(count * sizeof(float));
+    double* time = malloc(count * sizeof(double));
+    SpringLanes lanes = {position, target, velocity, damping, speed, time, NULL};
+    for (size_t i = 0; i < count; i++) {
+        position[i] = 1.0f;
+        target[i] = 0.0f;
+        velocity[i] = 0.0f;
+        damping[i] = 0.5f;
+        speed[i] = 10.0f;
+        time[i] = 0.0;
+    }
+    
+    double now = 0.0;
+    for (int window = 0; window < 16; window++) {
+        clock_t start = clock();
+        for (int frame = 0; frame < 100; frame++) {
+            now += 1.0 / 60.0;
+            spring_lanes_evaluate(&lanes, count, now);
+        }
+        const double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        printf("frames %4d: %.2f ns, velocity %g\n",
+            window * 100, seconds * 1e9 / (100.0 * count), velocity[0]);
+    }
+    
+    free(position);
+    free(target);
+    free(velocity);
+    free(damping);
+    free(speed);
+    free(time);
+}
+/**/
+
+// Turn into "//*" to remove comment
+/*
+// Nanoseconds per element renormalizing drifted unit quaternions, one in
+// eight of them by more than the tolerance.
+void run_normalize_benchmark() {
+    const size_t count = 4096;
+    const int rounds = 2000;
+    Quaternion* values = malloc(count * sizeof(Quaternion));
+    Quaternion* out = malloc(count * sizeof(Quaternion));
+    
+    for (size_t i = 0; i < count; i++) {
+        const Quaternion q = quaternion_new(
+            (float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f,
+            (float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f
+        );
+        const Quaternion unit = quaternion_normalize(&q);
+        values[i] = quaternion_scale(&unit, i % 8 == 0 ? 1.0001f : 1.00000001f);
+    }
+    
+    clock_t start = clock();
+    for (int round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = quaternion_normalize(&(values[i]));
+        }
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("quaternion_normalize: %.2f ns\n", seconds * 1e9 / ((double)rounds * count));
+    
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        quaternion_normalize_batch(values, count, 0.0f, out);
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("quaternion_normalize_batch: %.2f ns\n", seconds * 1e9 / ((double)rounds * count));
+    
+    start = clock();
+    for (int round = 0; round < rounds; round++) {
+        quaternion_normalize_batch(values, count, 2e-6f, out);
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("quaternion_normalize_batch, skipping: %.2f ns\n", seconds * 1e9 / ((double)rounds * count));
+    
+    float worst = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        quaternion_normalize_batch(&(values[i]), 1, 0.0f, &(out[i]));
+        worst = fmaxf(worst, fabsf(quaternion_length(&(out[i])) - 1.0f));
+    }
+    quaternion_normalize_batch(values, count, 0.0f, out);
+    for (size_t i = 0; i < count; i++) {
+        worst = fmaxf(worst, fabsf(quaternion_length(&(out[i])) - 1.0f));
+    }
+    printf("largest length error: %g\n", worst);
+    
+    free(values);
+    free(out);
+}
+/**/
+
+// Turn into "//*" to remove comment
+/*
+static double timer_time = 0.0;
+static int timer_fired_tick = -1;
+static int timer_tick = 0;
+
+static double timer_clock(void* state) {
+    return timer_time;
+}
+
+static void timer_fired(QuaternionSpring* spring, void* user_data) {
+    timer_fired_tick = timer_tick;
+}
+
+// Schedules a spring to settle exactly on a level boundary of the timer
+// wheel, where it is cascaded into the level 0 slot being drained, and
+// checks that it fires on that tick rather than the next.
+void run_timer_wheel_test() {
+    const int boundaries[] = {64, 128, 4096};
+    
+    for (size_t i = 0; i < sizeof(boundaries) / sizeof(int); i++) {
+        const int boundary = boundaries[i];
+        
+        QuaternionSpring spring;
+        quaternion_spring_new(
+            &QUATERNION_IDENTITY, 0.5f, 4.0f, timer_clock, NULL, &spring
+        );
+        const Quaternion target = quaternion_from_axis_angle(&VECTOR3_Y_AXIS, 1.0f);
+        quaternion_spring_set_target(&spring, &target);
+        
+        // Puts the settle time in the middle of the tick before the boundary.
+        const double settle_time = quaternion_spring_settle_time(&spring, 1e-3f);
+        const double tick_length = settle_time / (boundary - 0.5);
+        
+        SpringTimerWheel wheel;
+        SpringTimer timer;
+        spring_timer_wheel_init(&wheel, 0.0, tick_length);
+        spring_timer_init(&timer);
+        spring_timer_schedule(&wheel, &timer, &spring, 1e-3f, timer_fired, NULL);
+        
+        timer_fired_tick = -1;
+        for (timer_tick = 1; timer_tick <= boundary + 2 && timer_fired_tick < 0; timer_tick++) {
+            spring_timer_wheel_advance(&wheel, (timer_tick + 0.5) * tick_length);
+        }
+        printf("settle on tick %d: fired on tick %d, %s\n",
+            boundary, timer_fired_tick, timer_fired_tick == boundary ? "ok" : "FAILED");
+    }
+}
+/**/
+
 int main() { //int argc, char** argv) {
     Vector3 axis = vector3_new(0, 0, 1);
     const float angle = 30.0f;